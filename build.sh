@@ -1,6 +1,7 @@
 #!/bin/bash
 IMAGE=eoslaomao/eos-dev:1.2.3
 NAME=bankofstaked
+ADMIN=bankadmin
 FOLDER=bankofstaked
 
 docker ps | grep $NAME-eos-dev
@@ -11,10 +12,20 @@ fi
 
 docker exec $NAME-eos-dev eosiocpp -g /$NAME/$NAME.abi /$NAME/src/$NAME.cpp
 docker exec $NAME-eos-dev eosiocpp -o /$NAME/$NAME.wast /$NAME/src/$NAME.cpp
+# admin actions are a contract of their own, deployed on bankadmin
+docker exec $NAME-eos-dev eosiocpp -g /$NAME/$ADMIN.abi /$NAME/src/$ADMIN.cpp
+docker exec $NAME-eos-dev eosiocpp -o /$NAME/$ADMIN.wast /$NAME/src/$ADMIN.cpp
+# PROFILE=1 ./build.sh also builds the instrumentation variant counting DB operations per action
+if [ "$PROFILE" = "1" ]; then
+    docker exec $NAME-eos-dev eosiocpp -o /$NAME/${NAME}_profile.wast /$NAME/src/${NAME}_profile.cpp
+fi
 docker exec nodeosd mkdir /$NAME
 docker cp ../$FOLDER/$NAME.abi nodeosd:/$NAME/
 docker cp ../$FOLDER/$NAME.wasm nodeosd:/$NAME/
 docker cp ../$FOLDER/$NAME.wast nodeosd:/$NAME/
+docker cp ../$FOLDER/$ADMIN.abi nodeosd:/$NAME/
+docker cp ../$FOLDER/$ADMIN.wasm nodeosd:/$NAME/
+docker cp ../$FOLDER/$ADMIN.wast nodeosd:/$NAME/
 docker cp scripts nodeosd:/
 
 
@@ -27,6 +38,13 @@ fi
 mv $NAME.abi ./build
 mv $NAME.wast ./build
 mv $NAME.wasm ./build
+mv $ADMIN.abi ./build
+mv $ADMIN.wast ./build
+mv $ADMIN.wasm ./build
+if [ "$PROFILE" = "1" ]; then
+    mv ${NAME}_profile.wast ./build
+    mv ${NAME}_profile.wasm ./build
+fi
 
 echo "Build SUCCESS!!!"
 
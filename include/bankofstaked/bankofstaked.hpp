@@ -1,9 +1,16 @@
 /**
  *  @file bankofstaked.hpp
+ *
+ *  Tables shared by bankofstaked and bankadmin. config, plan, plandir, safecreditor,
+ *  blacklist and whitelist are owned by ADMIN_ACCOUNT, bankofstaked only reads them.
  */
+#pragma once
+
+#include <algorithm>
 #include <eosiolib/asset.hpp>
 #include <eosiolib/eosio.hpp>
 #include <eosiolib/multi_index.hpp>
+#include <eosiolib/singleton.hpp>
 
 #define EOS_SYMBOL S(4, EOS)
 
@@ -13,6 +20,8 @@ namespace bank
 {
 static const account_name CODE_ACCOUNT = N(bankofstaked);
 static const account_name RAM_PAYER = N(bankofstaked);
+static const account_name ADMIN_ACCOUNT = N(bankadmin); // runs admin actions, owns tables they write
+static const account_name ADMIN_RAM_PAYER = N(bankadmin);
 static const account_name MASK_TRANSFER = N(masktransfer);
 static const account_name STAKED_INCOME = N(stakedincome);
 static const account_name EOSIO = string_to_name("eosio");
@@ -21,16 +30,93 @@ static const uint64_t SECONDS_PER_MIN = 60;
 static const uint64_t SECONDS_PER_DAY = 24 * 3600;
 static const uint64_t MAX_FREE_ORDERS = 5;
 static const uint64_t MAX_PAID_ORDERS = 20;
+static const uint64_t MAX_ORDER_LEGS = 5; // creditors an order could be split across at most
+static const int64_t MIN_LEG_STAKE = 10000; // 1 EOS staked at least by each creditor of a split order
 static const uint64_t TRUE = 1;
 static const uint64_t FALSE = 0;
 static const uint64_t CHECK_MAX_DEPTH = 3;
+static const uint64_t EXPIRE_ALL = ~uint64_t(0); // expire every segment of an order
+static const uint64_t COMPACT_EXPIRY = TRUE; // deferred expiry only carries order ids, actions are rebuilt by `expire`
+static const uint64_t MAX_EXPIRY_DELAY = 45 * SECONDS_PER_DAY; // max_transaction_delay of eosio, later expiry is scheduled again when it runs
 static const uint64_t MAX_EOS_BALANCE = 500 * 10000; // 500 EOS at most
 static const uint64_t MIN_FREE_CREDITOR_BALANCE = 10 * 10000; // 10 EOS at least
 static const uint64_t DEFAULT_DIVIDEND_PERCENTAGE = 90; // 90% income will be allocated to creditor
+static const uint64_t DEFAULT_FREE_SHARDS = 1; // active free creditors at the same time
+static const uint64_t DEFAULT_PAID_SHARDS = 1; // active paid creditors at the same time
+static const uint64_t MAX_SHARDS = 16;
+static const uint64_t DEFAULT_ROTATE_DEPTH = 10; // creditors examined at most for each rotation
+static const uint64_t DEFAULT_HIGH_WATERMARK = 200; // replacement needs 200% of exhausted balance
+static const uint64_t DEFAULT_LAG_THRESHOLD = 300; // 5 minutes behind expire_at, check expires more orders
+static const uint64_t DEFAULT_MAX_EXPIRY_BATCH = 10; // orders expired by each check at most
+static const uint64_t MAX_EXPIRY_BATCH = 50; // keep deferred expiry within CPU limit
+static const uint64_t ORDER_PARTITION_SECONDS = SECONDS_PER_DAY; // orders are partitioned into scopes by expiry day
+static const uint64_t ORDER_SEQ_BITS = 24; // order id is (expire_at << ORDER_SEQ_BITS | seq)
+static const int64_t DELBAND_RAM_BYTES = 160; // delband row of eosio billed to creditor for each beneficiary it delegates to
+static const int64_t CREDITOR_RAM_RESERVED = 4096; // RAM creditor uses besides delband rows, account, balance and refund
+static const uint64_t REFUND_DELAY = 3 * SECONDS_PER_DAY; // eosio refunds unstaked tokens 3 days after last undelegatebw
+static const uint64_t REFUND_RETRY = 600; // seconds before a refund sent by maintenance is looked at again
+static const uint64_t ROWS_MIGRATED = 4; // step of rowmigration once every table is copied to bankadmin
 
 // To protect your table, you can specify different scope as random numbers
 static const uint64_t SCOPE = 921459758687;
 
+// @abi table config i64
+struct config
+{
+  uint64_t free_shards; // number of active free creditors serving orders at the same time
+  uint64_t paid_shards; // number of active paid creditors serving orders at the same time
+  uint64_t rotate_depth;   // creditors examined at most for each rotation
+  uint64_t high_watermark; // percentage of low watermark balance a replacement creditor needs
+  uint64_t lag_threshold;  // seconds behind expire_at before check grows its expiry batch
+  uint64_t max_batch;      // orders expired by each check at most
+
+  EOSLIB_SERIALIZE(config, (free_shards)(paid_shards)(rotate_depth)(high_watermark)(lag_threshold)(max_batch));
+};
+typedef singleton<N(config), config> config_table;
+
+// @abi table expirystat i64
+struct expirystat
+{
+  uint64_t backlog;    // overdue orders seen by last check, at most max_batch are counted
+  uint64_t lag;        // seconds the oldest overdue order was behind expire_at at last check
+  uint64_t max_lag;    // max seconds between expire_at and actual expiry of segments
+  uint64_t batch;      // orders expired by each check
+  uint64_t updated_at; // unix time, in seconds
+
+  EOSLIB_SERIALIZE(expirystat, (backlog)(lag)(max_lag)(batch)(updated_at));
+};
+typedef singleton<N(expirystat), expirystat> expirystat_table;
+
+// @abi table rotation i64
+struct rotation
+{
+  account_name free_cursor; // last creditor examined to replace free creditors
+  account_name paid_cursor; // last creditor examined to replace paid creditors
+
+  EOSLIB_SERIALIZE(rotation, (free_cursor)(paid_cursor));
+};
+typedef singleton<N(rotation), rotation> rotation_table;
+
+// @abi table metrics i64
+struct metrics
+{
+  uint64_t free_orders;  // live free orders
+  uint64_t paid_orders;  // live paid orders
+  asset cpu_staked;      // amount of EOS staked for cpu by live orders
+  asset net_staked;      // amount of EOS staked for net by live orders
+  uint64_t purchases;    // purchases creating a new order
+  uint64_t renewals;     // purchases renewing a segment of live order
+  uint64_t topups;       // purchases merged into live order as a new segment
+  uint64_t splits;       // purchases split across creditors
+  uint64_t free_expired; // expired free segments
+  uint64_t paid_expired; // expired paid segments
+  uint64_t rotations;    // creditors activated by rotation
+  uint64_t checked_at;   // unix time of last check which expired, rotated or settled refunds, in seconds
+
+  EOSLIB_SERIALIZE(metrics, (free_orders)(paid_orders)(cpu_staked)(net_staked)(purchases)(renewals)(topups)(splits)(free_expired)(paid_expired)(rotations)(checked_at));
+};
+typedef singleton<N(metrics), metrics> metrics_table;
+
 // @abi table freelock i64
 struct freelock
 {
@@ -48,34 +134,110 @@ typedef multi_index<N(freelock), freelock,
                     indexed_by<N(expire_at), const_mem_fun<freelock, uint64_t, &freelock::get_expire_at>>>
     freelock_table;
 
+// purchase merged into an order, or one leg of a purchase split across creditors,
+// expires on its own
+struct segment
+{
+  account_name creditor; // account who delegated CPU&NET of this segment
+  uint64_t plan_id;    // foreignkey of table plan
+  asset price;         // amount of EOS paied
+  asset cpu;           // amount of EOS staked for cpu
+  asset net;           // amount of EOS staked for net
+  uint64_t created_at; // unix time, in seconds
+  uint64_t expire_at;  // unix time, in seconds
+
+  EOSLIB_SERIALIZE(segment, (creditor)(plan_id)(price)(cpu)(net)(created_at)(expire_at));
+};
+
 // @abi table order i64
 struct order
 {
-  uint64_t id;
+  uint64_t id;              // (expire_at << ORDER_SEQ_BITS | seq), changes with expire_at
   account_name buyer;
-  asset price;              // amount of EOS paied
+  asset price;              // amount of EOS paied, sum of segments
   uint64_t is_free;         // default is FALSE, for free plan, when service expired, it will do a auto refund
-  account_name creditor;    // account who delegated CPU&NET
+  account_name creditor;    // account who delegated CPU&NET, first leg for orders split across creditors
   account_name beneficiary; // account who received CPU&NET
-  uint64_t plan_id;         // foreignkey of table plan
-  asset cpu_staked;         // amount of EOS staked for cpu
-  asset net_staked;         // amount of EOS staked for net
+  uint64_t plan_id;         // foreignkey of table plan, plan of the first segment
+  asset cpu_staked;         // amount of EOS staked for cpu, sum of segments
+  asset net_staked;         // amount of EOS staked for net, sum of segments
   uint64_t created_at;      // unix time, in seconds
-  uint64_t expire_at;       // unix time, in seconds
+  uint64_t expire_at;       // unix time, in seconds, earliest expiry of segments
+  uint64_t sender_id;       // lower 64 bits of sender id of deferred expiry transaction, first id of order
+  std::vector<segment> segments; // purchases of the same creditor and beneficiary
+
+  auto primary_key() const { return id; }
+
+  EOSLIB_SERIALIZE(order, (id)(buyer)(price)(is_free)(creditor)(beneficiary)(plan_id)(cpu_staked)(net_staked)(created_at)(expire_at)(sender_id)(segments));
+};
+
+// primary key is ordered by expire_at, orders are looked up by account through orderidx.
+// orders of partition p live in scope SCOPE + p, p is expire_at / ORDER_PARTITION_SECONDS.
+// scope SCOPE itself only holds legacyorder rows, until they are migrated
+typedef multi_index<N(order), order> order_table;
+
+// @abi table orderidx i64
+struct orderidx
+{
+  uint64_t sender_id;       // sender_id of order, kept while order moves across partitions
+  uint64_t order_id;        // current id of order, its partition follows from it
+  account_name buyer;
+  account_name beneficiary;
+  uint64_t is_free;
+
+  auto primary_key() const { return sender_id; }
+  uint128_t get_buyer_key() const { return (uint128_t(buyer) << 64) | is_free; }
+  uint128_t get_beneficiary_key() const { return (uint128_t(beneficiary) << 64) | is_free; }
+
+  EOSLIB_SERIALIZE(orderidx, (sender_id)(order_id)(buyer)(beneficiary)(is_free));
+};
+
+// live orders of all partitions in scope SCOPE, buyer and beneficiary indices are keyed by (account << 64 | is_free)
+typedef multi_index<N(orderidx), orderidx,
+                    indexed_by<N(buyer), const_mem_fun<orderidx, uint128_t, &orderidx::get_buyer_key>>,
+                    indexed_by<N(beneficiary), const_mem_fun<orderidx, uint128_t, &orderidx::get_beneficiary_key>>>
+    orderidx_table;
+
+// order as written by versions before segments and partitions, rows of it are left in scope SCOPE
+// with idx64 buyer, expire_at and beneficiary indices until `migrate` moves them into partitions
+struct legacyorder
+{
+  uint64_t id;
+  account_name buyer;
+  asset price;
+  uint64_t is_free;
+  account_name creditor;
+  account_name beneficiary;
+  uint64_t plan_id;
+  asset cpu_staked;
+  asset net_staked;
+  uint64_t created_at;
+  uint64_t expire_at;
 
   auto primary_key() const { return id; }
   account_name get_buyer() const { return buyer; }
   account_name get_beneficiary() const { return beneficiary; }
   uint64_t get_expire_at() const { return expire_at; }
 
-  EOSLIB_SERIALIZE(order, (id)(buyer)(price)(is_free)(creditor)(beneficiary)(plan_id)(cpu_staked)(net_staked)(created_at)(expire_at));
+  EOSLIB_SERIALIZE(legacyorder, (id)(buyer)(price)(is_free)(creditor)(beneficiary)(plan_id)(cpu_staked)(net_staked)(created_at)(expire_at));
 };
 
-typedef multi_index<N(order), order,
-                    indexed_by<N(buyer), const_mem_fun<order, account_name, &order::get_buyer>>,
-                    indexed_by<N(expire_at), const_mem_fun<order, uint64_t, &order::get_expire_at>>,
-                    indexed_by<N(beneficiary), const_mem_fun<order, account_name, &order::get_beneficiary>>>
-    order_table;
+typedef multi_index<N(order), legacyorder,
+                    indexed_by<N(buyer), const_mem_fun<legacyorder, account_name, &legacyorder::get_buyer>>,
+                    indexed_by<N(expire_at), const_mem_fun<legacyorder, uint64_t, &legacyorder::get_expire_at>>,
+                    indexed_by<N(beneficiary), const_mem_fun<legacyorder, account_name, &legacyorder::get_beneficiary>>>
+    legacyorder_table;
+
+// written on every new order id, as next_seq advances
+// @abi table orderdir i64
+struct orderdir
+{
+  std::vector<uint64_t> partitions; // partitions having live orders, ascending
+  uint64_t next_seq;                // seq of next order id, wraps at ORDER_SEQ_BITS
+
+  EOSLIB_SERIALIZE(orderdir, (partitions)(next_seq));
+};
+typedef singleton<N(orderdir), orderdir> orderdir_table;
 
 // @abi table history
 struct history
@@ -103,12 +265,31 @@ struct plan
   uint64_t updated_at; // unix time, in seconds
 
   auto primary_key() const { return id; }
-  uint64_t get_price() const { return (uint64_t)price.amount; }
   EOSLIB_SERIALIZE(plan, (id)(price)(cpu)(net)(duration)(is_free)(is_active)(created_at)(updated_at));
 };
-typedef multi_index<N(plan), plan,
-                    indexed_by<N(price), const_mem_fun<plan, uint64_t, &plan::get_price>>>
-    plan_table;
+typedef multi_index<N(plan), plan> plan_table;
+
+// @abi table plandir i64
+struct plandir
+{
+  std::vector<plan> plans; // copy of plan table ordered by price, purchases resolve plan from it in one read
+
+  EOSLIB_SERIALIZE(plandir, (plans));
+};
+typedef singleton<N(plandir), plandir> plandir_table;
+
+// plan of setplans
+struct planparam
+{
+  asset price;
+  asset cpu;
+  asset net;
+  uint64_t duration; // in minutes
+  bool is_free;
+  bool is_active;
+
+  EOSLIB_SERIALIZE(planparam, (price)(cpu)(net)(duration)(is_free)(is_active));
+};
 
 // @abi table safecreditor i64
 struct safecreditor
@@ -145,23 +326,112 @@ struct creditor
   asset balance;              // amount of EOS paied
   asset cpu_staked;              // amount of EOS paied
   asset net_staked;              // amount of EOS paied
-  asset cpu_unstaked;              // amount of EOS paied
-  asset net_unstaked;              // amount of EOS paied
+  asset cpu_unstaked;              // amount of EOS unstaked and not refunded yet
+  asset net_unstaked;              // amount of EOS unstaked and not refunded yet
   uint64_t created_at; // unix time, in seconds
   uint64_t updated_at; // unix time, in seconds
+  asset available;            // amount of EOS left to delegate, reconciled with balance in maintenance
+  int64_t ram_bytes;          // RAM quota of creditor, read from eosio userres in maintenance, 0 if unknown
+  uint64_t delegations;       // live delegations, each holding a delband row on creditor's RAM
 
   account_name primary_key() const { return account; }
   uint64_t get_is_active() const { return is_active; }
-  uint64_t get_updated_at() const { return updated_at; }
 
-  EOSLIB_SERIALIZE(creditor, (account)(is_active)(for_free)(free_memo)(balance)(cpu_staked)(net_staked)(cpu_unstaked)(net_unstaked)(created_at)(updated_at));
+  EOSLIB_SERIALIZE(creditor, (account)(is_active)(for_free)(free_memo)(balance)(cpu_staked)(net_staked)(cpu_unstaked)(net_unstaked)(created_at)(updated_at)(available)(ram_bytes)(delegations));
 };
 
 typedef multi_index<N(creditor), creditor,
-                    indexed_by<N(is_active), const_mem_fun<creditor, uint64_t, &creditor::get_is_active>>,
-                    indexed_by<N(updated_at), const_mem_fun<creditor, uint64_t, &creditor::get_updated_at>>>
+                    indexed_by<N(is_active), const_mem_fun<creditor, uint64_t, &creditor::get_is_active>>>
     creditor_table;
 
+// creditor as written by earlier versions, with is_active and updated_at indices, until `migrate` converts it
+struct legacycreditor
+{
+  account_name account;
+  uint64_t is_active;
+  uint64_t for_free;
+  string free_memo;
+  asset balance;
+  asset cpu_staked;
+  asset net_staked;
+  asset cpu_unstaked;
+  asset net_unstaked;
+  uint64_t created_at;
+  uint64_t updated_at;
+
+  account_name primary_key() const { return account; }
+  uint64_t get_is_active() const { return is_active; }
+  uint64_t get_updated_at() const { return updated_at; }
+
+  EOSLIB_SERIALIZE(legacycreditor, (account)(is_active)(for_free)(free_memo)(balance)(cpu_staked)(net_staked)(cpu_unstaked)(net_unstaked)(created_at)(updated_at));
+};
+
+typedef multi_index<N(creditor), legacycreditor,
+                    indexed_by<N(is_active), const_mem_fun<legacycreditor, uint64_t, &legacycreditor::get_is_active>>,
+                    indexed_by<N(updated_at), const_mem_fun<legacycreditor, uint64_t, &legacycreditor::get_updated_at>>>
+    legacycreditor_table;
+
+// @abi table migration i64
+struct migration
+{
+  uint64_t creditors; // TRUE once creditor rows are in the current layout
+
+  EOSLIB_SERIALIZE(migration, (creditors));
+};
+typedef singleton<N(migration), migration> migration_table;
+
+// creditor of addcreditors
+struct creditorparam
+{
+  account_name account;
+  uint64_t for_free;
+  string free_memo;
+
+  EOSLIB_SERIALIZE(creditorparam, (account)(for_free)(free_memo));
+};
+
+// row of eosio userres table, scope and primary key are the owner
+struct userres
+{
+  account_name owner;
+  asset net_weight;
+  asset cpu_weight;
+  int64_t ram_bytes;
+
+  account_name primary_key() const { return owner; }
+  EOSLIB_SERIALIZE(userres, (owner)(net_weight)(cpu_weight)(ram_bytes));
+};
+typedef multi_index<N(userres), userres> userres_table;
+
+// @abi table refunding i64
+struct refunding
+{
+  account_name creditor;
+  asset cpu;           // unstaked cpu waiting for eosio refund
+  asset net;           // unstaked net waiting for eosio refund
+  uint64_t matures_at; // unix time, in seconds, every undelegatebw of creditor restarts its eosio refund
+
+  account_name primary_key() const { return creditor; }
+  uint64_t get_matures_at() const { return matures_at; }
+  EOSLIB_SERIALIZE(refunding, (creditor)(cpu)(net)(matures_at));
+};
+typedef multi_index<N(refunding), refunding,
+                    indexed_by<N(matures_at), const_mem_fun<refunding, uint64_t, &refunding::get_matures_at>>>
+    refunding_table;
+
+// row of eosio refunds table, scope and primary key are the owner
+struct refundreq
+{
+  account_name owner;
+  uint32_t request_time; // unix time, in seconds
+  asset net_amount;
+  asset cpu_amount;
+
+  account_name primary_key() const { return owner; }
+  EOSLIB_SERIALIZE(refundreq, (owner)(request_time)(net_amount)(cpu_amount));
+};
+typedef multi_index<N(refunds), refundreq> refundreq_table;
+
 // @abi table blacklist i64
 struct blacklist
 {
@@ -186,6 +456,26 @@ struct whitelist
 };
 typedef multi_index<N(whitelist), whitelist> whitelist_table;
 
+// entry of setwhitelist, capacity 0 removes account from whitelist
+struct whitelistparam
+{
+  account_name account;
+  uint64_t capacity;
+
+  EOSLIB_SERIALIZE(whitelistparam, (account)(capacity));
+};
+
+// @abi table rowmigration i64
+// progress of bankadmin migrate, copying rows bankofstaked wrote before bankadmin owned them
+struct rowmigration
+{
+  uint64_t step;       // 0 config and plans, 1 safecreditor, 2 blacklist, 3 whitelist, then ROWS_MIGRATED
+  account_name cursor; // last account copied from table of step
+
+  EOSLIB_SERIALIZE(rowmigration, (step)(cursor));
+};
+typedef singleton<N(rowmigration), rowmigration> rowmigration_table;
+
 }// namespace bank
 
 
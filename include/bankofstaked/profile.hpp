@@ -0,0 +1,99 @@
+/**
+ *  @file profile.hpp
+ *
+ *  Instrumentation build, enabled by defining BANK_PROFILE before any eosiolib
+ *  header is included (see src/bankofstaked_profile.cpp). Database intrinsics,
+ *  inline and deferred sends are counted per action and printed at the end of apply.
+ *  Reads of tables owned by other contracts, e.g. eosio.token balances, are
+ *  counted as external reads instead of finds.
+ */
+#pragma once
+
+#ifdef BANK_PROFILE
+
+#include <eosiolib/db.h>
+#include <eosiolib/action.h>
+#include <eosiolib/transaction.h>
+#include <eosiolib/print.hpp>
+
+namespace profile
+{
+  struct counters
+  {
+    uint64_t finds;
+    uint64_t iterations;
+    uint64_t modifies;
+    uint64_t emplaces;
+    uint64_t erases;
+    uint64_t external_reads;
+    uint64_t inline_sends;
+    uint64_t deferred_sends;
+    uint64_t deferred_cancels;
+  };
+
+  // every action runs in a fresh instance, counters start from zero
+  static counters ops;
+  static uint64_t receiver;
+
+  inline void count_find(uint64_t code)
+  {
+    if(code == receiver) {
+      ops.finds++;
+    } else {
+      ops.external_reads++;
+    }
+  }
+
+  inline void print_ops(uint64_t code, uint64_t action)
+  {
+    eosio::print("profile ", eosio::name{code}, "::", eosio::name{action},
+                 " finds=", ops.finds,
+                 " iterations=", ops.iterations,
+                 " modifies=", ops.modifies,
+                 " emplaces=", ops.emplaces,
+                 " erases=", ops.erases,
+                 " external_reads=", ops.external_reads,
+                 " inline_sends=", ops.inline_sends,
+                 " deferred_sends=", ops.deferred_sends,
+                 " deferred_cancels=", ops.deferred_cancels, "\n");
+  }
+}
+
+// primary index
+#define db_find_i64(code, ...) (profile::count_find(code), ::db_find_i64(code, __VA_ARGS__))
+#define db_lowerbound_i64(code, ...) (profile::count_find(code), ::db_lowerbound_i64(code, __VA_ARGS__))
+#define db_upperbound_i64(code, ...) (profile::count_find(code), ::db_upperbound_i64(code, __VA_ARGS__))
+#define db_next_i64(...) (profile::ops.iterations++, ::db_next_i64(__VA_ARGS__))
+#define db_previous_i64(...) (profile::ops.iterations++, ::db_previous_i64(__VA_ARGS__))
+#define db_update_i64(...) (profile::ops.modifies++, ::db_update_i64(__VA_ARGS__))
+#define db_store_i64(...) (profile::ops.emplaces++, ::db_store_i64(__VA_ARGS__))
+#define db_remove_i64(...) (profile::ops.erases++, ::db_remove_i64(__VA_ARGS__))
+
+// uint64_t secondary indices
+#define db_idx64_find_primary(code, ...) (profile::count_find(code), ::db_idx64_find_primary(code, __VA_ARGS__))
+#define db_idx64_find_secondary(code, ...) (profile::count_find(code), ::db_idx64_find_secondary(code, __VA_ARGS__))
+#define db_idx64_lowerbound(code, ...) (profile::count_find(code), ::db_idx64_lowerbound(code, __VA_ARGS__))
+#define db_idx64_upperbound(code, ...) (profile::count_find(code), ::db_idx64_upperbound(code, __VA_ARGS__))
+#define db_idx64_next(...) (profile::ops.iterations++, ::db_idx64_next(__VA_ARGS__))
+#define db_idx64_previous(...) (profile::ops.iterations++, ::db_idx64_previous(__VA_ARGS__))
+#define db_idx64_update(...) (profile::ops.modifies++, ::db_idx64_update(__VA_ARGS__))
+#define db_idx64_store(...) (profile::ops.emplaces++, ::db_idx64_store(__VA_ARGS__))
+#define db_idx64_remove(...) (profile::ops.erases++, ::db_idx64_remove(__VA_ARGS__))
+
+// uint128_t secondary indices
+#define db_idx128_find_primary(code, ...) (profile::count_find(code), ::db_idx128_find_primary(code, __VA_ARGS__))
+#define db_idx128_find_secondary(code, ...) (profile::count_find(code), ::db_idx128_find_secondary(code, __VA_ARGS__))
+#define db_idx128_lowerbound(code, ...) (profile::count_find(code), ::db_idx128_lowerbound(code, __VA_ARGS__))
+#define db_idx128_upperbound(code, ...) (profile::count_find(code), ::db_idx128_upperbound(code, __VA_ARGS__))
+#define db_idx128_next(...) (profile::ops.iterations++, ::db_idx128_next(__VA_ARGS__))
+#define db_idx128_previous(...) (profile::ops.iterations++, ::db_idx128_previous(__VA_ARGS__))
+#define db_idx128_update(...) (profile::ops.modifies++, ::db_idx128_update(__VA_ARGS__))
+#define db_idx128_store(...) (profile::ops.emplaces++, ::db_idx128_store(__VA_ARGS__))
+#define db_idx128_remove(...) (profile::ops.erases++, ::db_idx128_remove(__VA_ARGS__))
+
+// transactions
+#define send_inline(...) (profile::ops.inline_sends++, ::send_inline(__VA_ARGS__))
+#define send_deferred(...) (profile::ops.deferred_sends++, ::send_deferred(__VA_ARGS__))
+#define cancel_deferred(...) (profile::ops.deferred_cancels++, ::cancel_deferred(__VA_ARGS__))
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ *  @file bankofstaked_bench.cpp
+ *
+ *  Microbenchmarks of contract logic built against the mock eosiolib,
+ *  orders or creditors are seeded directly into tables, from 1k to 1M rows.
+ *  Operation counters are reported per iteration.
+ */
+#include <benchmark/benchmark.h>
+#include <contracts.hpp>
+#include <fixture.hpp>
+
+namespace
+{
+  const account_name PAID_CREDITOR = N(paidcreditor);
+  const account_name FREE_CREDITOR = N(freecreditor);
+
+  enum seed_kind
+  {
+    SEED_NONE,
+    SEED_ORDERS,
+    SEED_CREDITORS
+  };
+
+  seed_kind seeded_kind = SEED_NONE;
+  int64_t seeded_rows = 0;
+
+  //one active creditor of each kind, with enough balance for any number of iterations
+  void seed_bank()
+  {
+    mock::reset();
+    mock::set_now(fixture::GENESIS);
+    fixture::setup_plans();
+    fixture::addcreditor(PAID_CREDITOR, false, asset(1000000000LL * 10000, EOS_SYMBOL));
+    fixture::addcreditor(FREE_CREDITOR, true, asset(1000000000LL * 10000, EOS_SYMBOL));
+    fixture::activate(PAID_CREDITOR);
+    fixture::activate(FREE_CREDITOR);
+  }
+
+  //rows paid orders of distinct beneficiaries, expiring evenly over the next week
+  void seed_orders(int64_t rows)
+  {
+    if (seeded_kind == SEED_ORDERS && seeded_rows == rows)
+    {
+      return;
+    }
+    seed_bank();
+    for (int64_t i = 0; i < rows; i++)
+    {
+      fixture::add_order(fixture::account("user", i), PAID_CREDITOR,
+                         fixture::GENESIS + 60 + i * 7 * SECONDS_PER_DAY / rows);
+    }
+    fixture::clear();
+    seeded_kind = SEED_ORDERS;
+    seeded_rows = rows;
+  }
+
+  //rows inactive paid creditors below high watermark, the active one is exhausted,
+  //so every rotation examines rotate_depth creditors without a replacement
+  void seed_creditors(int64_t rows)
+  {
+    if (seeded_kind == SEED_CREDITORS && seeded_rows == rows)
+    {
+      return;
+    }
+    seed_bank();
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    c.modify(c.find(PAID_CREDITOR), RAM_PAYER, [&](auto &i) {
+      i.available = asset(0, EOS_SYMBOL);
+    });
+    for (int64_t i = 0; i < rows; i++)
+    {
+      account_name account = fixture::account("cred", i);
+      mock::set_balance(account, asset(150000, EOS_SYMBOL));
+      c.emplace(RAM_PAYER, [&](auto &r) {
+        r.account = account;
+        r.is_active = FALSE;
+        r.for_free = FALSE;
+        r.balance = asset(150000, EOS_SYMBOL);
+        r.available = r.balance;
+        r.created_at = now();
+        r.updated_at = 0;
+      });
+    }
+    fixture::clear();
+    seeded_kind = SEED_CREDITORS;
+    seeded_rows = rows;
+  }
+
+  void report_ops(benchmark::State &state)
+  {
+    const mock::counters &ops = mock::current().ops;
+    auto avg = benchmark::Counter::kAvgIterations;
+    state.counters["finds"] = benchmark::Counter(ops.finds, avg);
+    state.counters["iterations"] = benchmark::Counter(ops.iterations, avg);
+    state.counters["writes"] = benchmark::Counter(ops.modifies + ops.emplaces + ops.erases, avg);
+    state.counters["external_reads"] = benchmark::Counter(ops.external_reads, avg);
+    fixture::clear();
+  }
+
+  //paid purchase of a new buyer, the order it creates is dropped outside of timing
+  void BM_received_token(benchmark::State &state)
+  {
+    seed_orders(state.range(0));
+    mock::set_now(fixture::GENESIS);
+    uint64_t n = 0;
+    mock::counters ops = {};
+    for (auto _ : state)
+    {
+      fixture::transfer(fixture::account("buyer", n++), asset(fixture::PAID_PRICE, EOS_SYMBOL));
+      state.PauseTiming();
+      ops = mock::current().ops;
+      uint64_t id = ((now() + 7 * SECONDS_PER_DAY) << ORDER_SEQ_BITS) | (get_orderdir().next_seq - 1);
+      order_table o(CODE_ACCOUNT, get_order_scope(id));
+      mock::cancel(get_sender_id(id));
+      o.erase(o.find(id));
+      remove_order_index(id);
+      mock::current().inline_actions.clear();
+      mock::current().ops = ops;
+      state.ResumeTiming();
+    }
+    report_ops(state);
+  }
+
+  //check with max_batch orders overdue, expiry is deferred so state stays the same
+  void BM_check(benchmark::State &state)
+  {
+    seed_orders(state.range(0));
+    mock::set_now(fixture::GENESIS + SECONDS_PER_DAY);
+    auto data = pack(std::make_tuple(PAID_CREDITOR));
+    for (auto _ : state)
+    {
+      fixture::push(N(check), data);
+    }
+    report_ops(state);
+  }
+
+  void BM_rotate_creditor(benchmark::State &state)
+  {
+    seed_creditors(state.range(0));
+    mock::set_now(fixture::GENESIS);
+    mock::current().receiver = CODE_ACCOUNT;
+    for (auto _ : state)
+    {
+      rotate_creditor();
+    }
+    report_ops(state);
+  }
+
+  void BM_validate_buyer(benchmark::State &state)
+  {
+    int64_t rows = state.range(0);
+    seed_orders(rows);
+    mock::set_now(fixture::GENESIS);
+    mock::current().receiver = CODE_ACCOUNT;
+    uint64_t n = 0;
+    for (auto _ : state)
+    {
+      validate_buyer(fixture::account("user", n++ % rows), FALSE);
+    }
+    report_ops(state);
+  }
+
+  void BM_validate_beneficiary(benchmark::State &state)
+  {
+    int64_t rows = state.range(0);
+    seed_orders(rows);
+    mock::set_now(fixture::GENESIS);
+    mock::current().receiver = CODE_ACCOUNT;
+    uint64_t n = 0;
+    for (auto _ : state)
+    {
+      validate_beneficiary(fixture::account("user", n++ % rows), PAID_CREDITOR, FALSE);
+    }
+    report_ops(state);
+  }
+}
+
+BENCHMARK(BM_received_token)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_check)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_rotate_creditor)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_validate_buyer)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_validate_beneficiary)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,22 @@
+/**
+ *  @file contracts.hpp
+ *
+ *  bankofstaked and bankadmin built into one binary. Their entry points are renamed,
+ *  apply picks one of them by receiver, as the chain does by account.
+ */
+#pragma once
+
+#define BANK_APPLY bank_apply
+#define ADMIN_APPLY admin_apply
+
+#include <bankofstaked.cpp>
+#include <bankadmin.cpp>
+
+extern "C" [[noreturn]] void apply(uint64_t receiver, uint64_t code, uint64_t action)
+{
+  if (receiver == ADMIN_ACCOUNT)
+  {
+    admin_apply(receiver, code, action);
+  }
+  bank_apply(receiver, code, action);
+}
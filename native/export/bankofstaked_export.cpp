@@ -0,0 +1,244 @@
+/**
+ *  @file bankofstaked_export.cpp
+ *
+ *  Offline exporter of bankofstaked tables. Reads a nodeos portable snapshot, or one written by
+ *  bankofstaked_sim --snapshot, keeps rows of order, creditor, history, freelock and refunding
+ *  of --code and plan of --admin-code, and decodes them on a thread pool into one CSV file per table.
+ *
+ *    bankofstaked_export --snapshot=snapshot.bin --out=tables --threads=8
+ *
+ *  Assets are written as amounts in 0.0001 EOS, names as strings, segments of orders go to segment.csv.
+ */
+#include <eosiolib/eosio.hpp>
+#include <../include/bankofstaked/bankofstaked.hpp>
+#include <snapshot.hpp>
+#include <sim/thread_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace bank;
+
+namespace
+{
+  static const size_t CHUNK_ROWS = 4096; // rows decoded by a job
+
+  struct options
+  {
+    std::string snapshot;
+    std::string out = ".";
+    std::string code = "bankofstaked";
+    std::string admin_code = "bankadmin";
+    uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+  };
+
+  options parse_options(int argc, char **argv)
+  {
+    options o;
+    for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      size_t eq = arg.find('=');
+      eosio_assert(arg.compare(0, 2, "--") == 0 && eq != std::string::npos, ("expected --name=value, got " + arg).c_str());
+      std::string name = arg.substr(2, eq - 2);
+      std::string value = arg.substr(eq + 1);
+      if (name == "snapshot") o.snapshot = value;
+      else if (name == "out") o.out = value;
+      else if (name == "code") o.code = value;
+      else if (name == "admin-code") o.admin_code = value;
+      else if (name == "threads") o.threads = std::max<uint64_t>(1, std::stoull(value));
+      else eosio_assert(false, ("unknown option " + arg).c_str());
+    }
+    eosio_assert(!o.snapshot.empty(), "--snapshot is required");
+    return o;
+  }
+
+  std::string to_name(account_name value)
+  {
+    return name{value}.to_string();
+  }
+
+  //quoted, quotes doubled
+  std::string quote(const std::string &value)
+  {
+    std::string str = "\"";
+    for (char c : value)
+    {
+      str += c;
+      if (c == '"')
+      {
+        str += c;
+      }
+    }
+    return str + "\"";
+  }
+
+  //CSV lines of a row, segments of an order go to second output
+  void write_row(const snapshot::row &r, const char *data, std::ostream &out, std::ostream &segments)
+  {
+    if (r.table == N(order))
+    {
+      auto o = snapshot::unpack<order>(data, r.size);
+      out << r.scope << "," << o.id << "," << to_name(o.buyer) << "," << to_name(o.beneficiary) << ","
+          << to_name(o.creditor) << "," << o.is_free << "," << o.plan_id << "," << o.price.amount << ","
+          << o.cpu_staked.amount << "," << o.net_staked.amount << "," << o.created_at << ","
+          << o.expire_at << "," << o.sender_id << "," << o.segments.size() << "\n";
+      for (const auto &s : o.segments)
+      {
+        segments << r.scope << "," << o.id << "," << to_name(s.creditor) << "," << s.plan_id << ","
+                 << s.price.amount << "," << s.cpu.amount << "," << s.net.amount << ","
+                 << s.created_at << "," << s.expire_at << "\n";
+      }
+    }
+    else if (r.table == N(creditor))
+    {
+      auto c = snapshot::unpack<creditor>(data, r.size);
+      out << to_name(c.account) << "," << c.is_active << "," << c.for_free << "," << quote(c.free_memo) << ","
+          << c.balance.amount << "," << c.available.amount << "," << c.ram_bytes << "," << c.delegations << ","
+          << c.cpu_staked.amount << "," << c.net_staked.amount << "," << c.cpu_unstaked.amount << ","
+          << c.net_unstaked.amount << "," << c.created_at << "," << c.updated_at << "\n";
+    }
+    else if (r.table == N(history))
+    {
+      auto h = snapshot::unpack<history>(data, r.size);
+      out << h.id << "," << quote(h.content) << "," << h.created_at << "\n";
+    }
+    else if (r.table == N(freelock))
+    {
+      auto f = snapshot::unpack<freelock>(data, r.size);
+      out << to_name(f.beneficiary) << "," << f.created_at << "," << f.expire_at << "\n";
+    }
+    else if (r.table == N(refunding))
+    {
+      auto f = snapshot::unpack<refunding>(data, r.size);
+      out << to_name(f.creditor) << "," << f.cpu.amount << "," << f.net.amount << "," << f.matures_at << "\n";
+    }
+    else if (r.table == N(plan))
+    {
+      auto p = snapshot::unpack<plan>(data, r.size);
+      out << p.id << "," << p.price.amount << "," << p.cpu.amount << "," << p.net.amount << ","
+          << p.duration << "," << p.is_free << "," << p.is_active << "," << p.created_at << ","
+          << p.updated_at << "\n";
+    }
+  }
+
+  struct output
+  {
+    std::string file;
+    std::string header;
+  };
+
+  const std::map<uint64_t, output> OUTPUTS = {
+      {N(order), {"order.csv", "scope,id,buyer,beneficiary,creditor,is_free,plan_id,price,cpu_staked,net_staked,created_at,expire_at,sender_id,segments"}},
+      {N(creditor), {"creditor.csv", "account,is_active,for_free,free_memo,balance,available,ram_bytes,delegations,cpu_staked,net_staked,cpu_unstaked,net_unstaked,created_at,updated_at"}},
+      {N(history), {"history.csv", "id,content,created_at"}},
+      {N(freelock), {"freelock.csv", "beneficiary,created_at,expire_at"}},
+      {N(refunding), {"refunding.csv", "creditor,cpu,net,matures_at"}},
+      {N(plan), {"plan.csv", "id,price,cpu,net,duration,is_free,is_active,created_at,updated_at"}}};
+
+  const output SEGMENTS = {"segment.csv", "scope,order_id,creditor,plan_id,price,cpu,net,created_at,expire_at"};
+
+  //rows of a table split into chunks, chunk i is decoded into text[i] and segments[i]
+  struct table_job
+  {
+    std::vector<const snapshot::row *> rows;
+    std::vector<std::string> text;
+    std::vector<std::string> segments;
+  };
+}
+
+int main(int argc, char **argv)
+{
+  try
+  {
+    options o = parse_options(argc, argv);
+    auto started = std::chrono::steady_clock::now();
+
+    //plan is written by bankadmin, the other tables by bankofstaked
+    std::map<uint64_t, uint64_t> tables;
+    for (const auto &t : OUTPUTS)
+    {
+      tables[t.first] = string_to_name((t.first == N(plan) ? o.admin_code : o.code).c_str());
+    }
+    snapshot::reader snap(o.snapshot, tables);
+    double read_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::map<uint64_t, table_job> jobs;
+    for (const auto &r : snap.rows)
+    {
+      jobs[r.table].rows.push_back(&r);
+    }
+    for (auto &j : jobs)
+    {
+      size_t chunks = (j.second.rows.size() + CHUNK_ROWS - 1) / CHUNK_ROWS;
+      j.second.text.resize(chunks);
+      j.second.segments.resize(chunks);
+    }
+
+    std::mutex failure_mutex;
+    std::string failure;
+    {
+      sim::thread_pool pool(o.threads);
+      for (auto &j : jobs)
+      {
+        table_job &job = j.second;
+        for (size_t c = 0; c < job.text.size(); c++)
+        {
+          pool.submit([&, c] {
+            try
+            {
+              std::ostringstream out, segments;
+              size_t end = std::min(job.rows.size(), (c + 1) * CHUNK_ROWS);
+              for (size_t i = c * CHUNK_ROWS; i < end; i++)
+              {
+                write_row(*job.rows[i], snap.data(*job.rows[i]), out, segments);
+              }
+              job.text[c] = out.str();
+              job.segments[c] = segments.str();
+            }
+            catch (const std::exception &e)
+            {
+              std::lock_guard<std::mutex> lock(failure_mutex);
+              failure = e.what();
+            }
+          });
+        }
+      }
+    }
+    eosio_assert(failure.empty(), ("decoding failed: " + failure).c_str());
+
+    auto open = [&](const output &out) {
+      std::ofstream file(o.out + "/" + out.file);
+      eosio_assert(file.good(), ("cannot write " + o.out + "/" + out.file).c_str());
+      file << out.header << "\n";
+      return file;
+    };
+    for (const auto &t : OUTPUTS)
+    {
+      std::ofstream file = open(t.second);
+      for (const auto &text : jobs[t.first].text)
+      {
+        file << text;
+      }
+      std::cerr << t.second.file << ": " << jobs[t.first].rows.size() << " rows" << std::endl;
+    }
+    std::ofstream segments = open(SEGMENTS);
+    for (const auto &text : jobs[N(order)].segments)
+    {
+      segments << text;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cerr << snap.tables_seen << " tables read in " << read_seconds << "s, "
+              << snap.rows.size() << " rows exported in " << seconds << "s" << std::endl;
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,124 @@
+/**
+ *  @file fixture.hpp
+ *
+ *  Helpers to set up bankofstaked state in the host build,
+ *  include after contracts.hpp.
+ */
+#pragma once
+
+namespace fixture
+{
+  static const uint32_t GENESIS = 1540000000; // unix time chain starts at
+  static const uint64_t FREE_PRICE = 1000;    // 0.1 EOS
+  static const uint64_t PAID_PRICE = 10000;   // 1 EOS
+
+  //valid account name from prefix and index, index is spelled with letters a-z
+  inline account_name account(const std::string &prefix, uint64_t index)
+  {
+    std::string str = prefix;
+    std::string suffix;
+    do
+    {
+      suffix += char('a' + index % 26);
+      index /= 26;
+    } while (index > 0);
+    str.append(suffix.rbegin(), suffix.rend());
+    eosio_assert(str.size() <= 12, "account name is too long");
+    return string_to_name(str.c_str());
+  }
+
+  inline void push(action_name act, const std::vector<char> &data)
+  {
+    mock::call(CODE_ACCOUNT, CODE_ACCOUNT, act, data);
+  }
+
+  //action of bankadmin, e.g. plans and config
+  inline void admin(action_name act, const std::vector<char> &data)
+  {
+    mock::call(ADMIN_ACCOUNT, ADMIN_ACCOUNT, act, data);
+  }
+
+  inline void setplan(asset price, asset cpu, asset net, uint64_t duration, bool is_free)
+  {
+    admin(N(setplan), pack(std::make_tuple(price, cpu, net, duration, is_free)));
+    admin(N(activateplan), pack(std::make_tuple(price, true)));
+  }
+
+  //RAM quota of owner in eosio userres table
+  inline void set_ram(account_name owner, int64_t ram_bytes)
+  {
+    userres_table u(EOSIO, owner);
+    u.emplace(owner, [&](auto &r) {
+      r.owner = owner;
+      r.net_weight = asset(0, EOS_SYMBOL);
+      r.cpu_weight = asset(0, EOS_SYMBOL);
+      r.ram_bytes = ram_bytes;
+    });
+  }
+
+  //ram_bytes 0 leaves creditor without userres entry, its RAM is not limited
+  inline void addcreditor(account_name account, bool for_free, asset balance, int64_t ram_bytes = 0)
+  {
+    mock::set_balance(account, balance);
+    if (ram_bytes > 0)
+    {
+      set_ram(account, ram_bytes);
+    }
+    push(N(addcreditor), pack(std::make_tuple(account, uint64_t(for_free ? TRUE : FALSE), std::string(for_free ? "free" : ""))));
+  }
+
+  inline void activate(account_name account)
+  {
+    push(N(activate), pack(std::make_tuple(account)));
+  }
+
+  //transfer of eosio.token notified to bankofstaked
+  inline void transfer(account_name from, asset quantity, const std::string &memo = "")
+  {
+    currency::transfer t{from, CODE_ACCOUNT, quantity, memo};
+    mock::call(CODE_ACCOUNT, N(eosio.token), N(transfer), pack(t));
+  }
+
+  //free plan of 0.1 EOS and paid plan of 1 EOS, 10 EOS cpu and 1 EOS net for a week
+  inline void setup_plans()
+  {
+    std::vector<planparam> plans = {
+        {asset(FREE_PRICE, EOS_SYMBOL), asset(10000, EOS_SYMBOL), asset(1000, EOS_SYMBOL), 24 * 60, true, true},
+        {asset(PAID_PRICE, EOS_SYMBOL), asset(100000, EOS_SYMBOL), asset(10000, EOS_SYMBOL), 7 * 24 * 60, false, true}};
+    admin(N(setplans), pack(std::make_tuple(plans)));
+  }
+
+  //paid order of beneficiary served by creditor, stored without delegation and deferred expiry
+  inline void add_order(account_name beneficiary, account_name creditor, uint64_t expire_at)
+  {
+    uint64_t id = new_order_id(expire_at);
+    order_table o(CODE_ACCOUNT, get_order_scope(id));
+    auto created = o.emplace(RAM_PAYER, [&](auto &i) {
+      segment s;
+      s.creditor = creditor;
+      s.plan_id = 1;
+      s.price = asset(PAID_PRICE, EOS_SYMBOL);
+      s.cpu = asset(100000, EOS_SYMBOL);
+      s.net = asset(10000, EOS_SYMBOL);
+      s.created_at = now();
+      s.expire_at = expire_at;
+      i.id = id;
+      i.buyer = beneficiary;
+      i.beneficiary = beneficiary;
+      i.creditor = creditor;
+      i.is_free = FALSE;
+      i.created_at = now();
+      i.sender_id = i.id;
+      i.segments.emplace_back(s);
+      sum_segments(i);
+    });
+    add_order_index(*created);
+  }
+
+  //drop inline actions and counters, e.g. after setup
+  inline void clear()
+  {
+    mock::current().inline_actions.clear();
+    mock::current().ops = mock::counters();
+  }
+}
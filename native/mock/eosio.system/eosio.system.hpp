@@ -0,0 +1,30 @@
+/**
+ *  @file eosio.system.hpp
+ *
+ *  Only declarations of actions the contract sends inline.
+ */
+#pragma once
+
+#include <eosiolib/asset.hpp>
+#include <eosiolib/eosio.hpp>
+
+namespace eosiosystem
+{
+  using eosio::asset;
+
+  static constexpr uint64_t system_token_symbol = CORE_SYMBOL;
+
+  class system_contract : public eosio::contract
+  {
+  public:
+    using eosio::contract::contract;
+
+    void delegatebw(account_name from, account_name receiver,
+                    asset stake_net_quantity, asset stake_cpu_quantity, bool transfer);
+
+    void undelegatebw(account_name from, account_name receiver,
+                      asset unstake_net_quantity, asset unstake_cpu_quantity);
+
+    void refund(account_name owner);
+  };
+}
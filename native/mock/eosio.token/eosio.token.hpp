@@ -0,0 +1,71 @@
+/**
+ *  @file eosio.token.hpp
+ *
+ *  Balances are read from accounts table of eosio.token, seed them with mock::set_balance.
+ */
+#pragma once
+
+#include <eosiolib/asset.hpp>
+#include <eosiolib/eosio.hpp>
+#include <eosiolib/multi_index.hpp>
+
+namespace eosio
+{
+  using std::string;
+
+  class token : public contract
+  {
+  public:
+    token(account_name self) : contract(self) {}
+
+    void create(account_name issuer, asset maximum_supply);
+
+    void issue(account_name to, asset quantity, string memo);
+
+    void transfer(account_name from, account_name to, asset quantity, string memo);
+
+    inline asset get_balance(account_name owner, symbol_name sym) const;
+
+    struct account
+    {
+      asset balance;
+
+      uint64_t primary_key() const { return balance.symbol.name(); }
+    };
+
+    typedef eosio::multi_index<N(accounts), account> accounts;
+
+    struct transfer_args
+    {
+      account_name from;
+      account_name to;
+      asset quantity;
+      string memo;
+    };
+  };
+
+  asset token::get_balance(account_name owner, symbol_name sym) const
+  {
+    accounts accountstable(_self, owner);
+    const auto &ac = accountstable.get(sym);
+    return ac.balance;
+  }
+
+  namespace mock
+  {
+    //set token balance of owner, creating its accounts entry if needed
+    inline void set_balance(account_name owner, asset balance)
+    {
+      token::accounts accountstable(N(eosio.token), owner);
+      auto itr = accountstable.find(balance.symbol.name());
+      if (itr == accountstable.end())
+      {
+        accountstable.emplace(owner, [&](auto &a) { a.balance = balance; });
+      }
+      else
+      {
+        accountstable.modify(itr, owner, [&](auto &a) { a.balance = balance; });
+      }
+    }
+  }
+}
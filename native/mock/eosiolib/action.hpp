@@ -0,0 +1,67 @@
+/**
+ *  @file action.hpp
+ */
+#pragma once
+
+#include <eosiolib/serialize.hpp>
+
+namespace eosio
+{
+  namespace mock
+  {
+    // data of the action being applied, see eosiolib/mock.hpp
+    inline const std::vector<char> &action_data();
+  }
+
+  struct permission_level
+  {
+    permission_level(account_name a, permission_name p) : actor(a), permission(p) {}
+    permission_level() : actor(0), permission(0) {}
+
+    account_name actor;
+    permission_name permission;
+
+    friend bool operator==(const permission_level &a, const permission_level &b)
+    {
+      return a.actor == b.actor && a.permission == b.permission;
+    }
+
+    EOSLIB_SERIALIZE(permission_level, (actor)(permission))
+  };
+
+  struct action
+  {
+    account_name account;
+    action_name name;
+    std::vector<permission_level> authorization;
+    std::vector<char> data;
+
+    action() = default;
+
+    template <typename T>
+    action(const permission_level &auth, account_name a, action_name n, T &&value)
+        : account(a), name(n), authorization(1, auth), data(pack(std::forward<T>(value))) {}
+
+    template <typename T>
+    action(std::vector<permission_level> auths, account_name a, action_name n, T &&value)
+        : account(a), name(n), authorization(std::move(auths)), data(pack(std::forward<T>(value))) {}
+
+    // queued as inline action of the action being applied
+    inline void send() const;
+
+    EOSLIB_SERIALIZE(action, (account)(name)(authorization)(data))
+  };
+
+  template <typename T>
+  T unpack_action_data()
+  {
+    return unpack<T>(mock::action_data());
+  }
+}
+
+// authorization is not enforced in the host build
+inline void require_auth(account_name) {}
+inline bool has_auth(account_name) { return true; }
+
+// every non-empty name is an account
+inline bool is_account(account_name name) { return name != 0; }
@@ -0,0 +1,148 @@
+/**
+ *  @file asset.hpp
+ */
+#pragma once
+
+#include <eosiolib/serialize.hpp>
+
+namespace eosio
+{
+  static constexpr uint64_t string_to_symbol(uint8_t precision, const char *str)
+  {
+    uint32_t len = 0;
+    while (str[len])
+      ++len;
+
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < len; ++i)
+    {
+      if (str[i] >= 'A' && str[i] <= 'Z')
+      {
+        result |= (uint64_t(str[i]) << (8 * (1 + i)));
+      }
+    }
+    result |= uint64_t(precision);
+    return result;
+  }
+
+#define S(P, X) ::eosio::string_to_symbol(P, #X)
+
+// host build is always EOS based
+#ifndef CORE_SYMBOL
+#define CORE_SYMBOL S(4, EOS)
+#endif
+
+  struct symbol_type
+  {
+    symbol_name value;
+
+    symbol_type() {}
+    symbol_type(symbol_name s) : value(s) {}
+
+    bool is_valid() const
+    {
+      auto sym = value >> 8;
+      for (int i = 0; i < 7; ++i)
+      {
+        char c = (char)(sym & 0xff);
+        if (!('A' <= c && c <= 'Z'))
+          return false;
+        sym >>= 8;
+        if (!(sym & 0xff))
+        {
+          do
+          {
+            sym >>= 8;
+            if ((sym & 0xff))
+              return false;
+            ++i;
+          } while (i < 7);
+        }
+      }
+      return true;
+    }
+    uint64_t precision() const { return value & 0xff; }
+    uint64_t name() const { return value >> 8; }
+
+    operator symbol_name() const { return value; }
+
+    EOSLIB_SERIALIZE(symbol_type, (value))
+  };
+
+  struct asset
+  {
+    static constexpr int64_t max_amount = (1LL << 62) - 1;
+
+    int64_t amount;
+    symbol_type symbol;
+
+    explicit asset(int64_t a = 0, symbol_type s = CORE_SYMBOL)
+        : amount(a), symbol{s}
+    {
+      eosio_assert(is_amount_within_range(), "magnitude of asset amount must be less than 2^62");
+      eosio_assert(symbol.is_valid(), "invalid symbol name");
+    }
+
+    bool is_amount_within_range() const { return -max_amount <= amount && amount <= max_amount; }
+    bool is_valid() const { return is_amount_within_range() && symbol.is_valid(); }
+
+    asset operator-() const
+    {
+      asset r = *this;
+      r.amount = -r.amount;
+      return r;
+    }
+
+    asset &operator-=(const asset &a)
+    {
+      eosio_assert(a.symbol == symbol, "attempt to subtract asset with different symbol");
+      amount -= a.amount;
+      eosio_assert(-max_amount <= amount, "subtraction underflow");
+      eosio_assert(amount <= max_amount, "subtraction overflow");
+      return *this;
+    }
+
+    asset &operator+=(const asset &a)
+    {
+      eosio_assert(a.symbol == symbol, "attempt to add asset with different symbol");
+      amount += a.amount;
+      eosio_assert(-max_amount <= amount, "addition underflow");
+      eosio_assert(amount <= max_amount, "addition overflow");
+      return *this;
+    }
+
+    friend asset operator+(const asset &a, const asset &b)
+    {
+      asset result = a;
+      result += b;
+      return result;
+    }
+
+    friend asset operator-(const asset &a, const asset &b)
+    {
+      asset result = a;
+      result -= b;
+      return result;
+    }
+
+    friend bool operator==(const asset &a, const asset &b)
+    {
+      eosio_assert(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed");
+      return a.amount == b.amount;
+    }
+
+    friend bool operator!=(const asset &a, const asset &b) { return !(a == b); }
+
+    friend bool operator<(const asset &a, const asset &b)
+    {
+      eosio_assert(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed");
+      return a.amount < b.amount;
+    }
+
+    friend bool operator<=(const asset &a, const asset &b) { return !(b < a); }
+    friend bool operator>(const asset &a, const asset &b) { return b < a; }
+    friend bool operator>=(const asset &a, const asset &b) { return !(a < b); }
+
+    EOSLIB_SERIALIZE(asset, (amount)(symbol))
+  };
+}
@@ -0,0 +1,20 @@
+/**
+ *  @file contract.hpp
+ */
+#pragma once
+
+#include <eosiolib/types.hpp>
+
+namespace eosio
+{
+  class contract
+  {
+  public:
+    contract(account_name n) : _self(n) {}
+
+    inline account_name get_self() const { return _self; }
+
+  protected:
+    account_name _self;
+  };
+}
@@ -0,0 +1,23 @@
+/**
+ *  @file currency.hpp
+ */
+#pragma once
+
+#include <eosiolib/asset.hpp>
+
+namespace eosio
+{
+  class currency
+  {
+  public:
+    struct transfer
+    {
+      account_name from;
+      account_name to;
+      asset quantity;
+      string memo;
+
+      EOSLIB_SERIALIZE(transfer, (from)(to)(quantity)(memo))
+    };
+  };
+}
@@ -0,0 +1,52 @@
+/**
+ *  @file dispatcher.hpp
+ */
+#pragma once
+
+#include <eosiolib/action.hpp>
+#include <boost/preprocessor/facilities/overload.hpp>
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+namespace eosio
+{
+  template <typename T, typename Q, typename... Args>
+  bool execute_action(T *obj, void (Q::*func)(Args...))
+  {
+    auto args = unpack_action_data<std::tuple<std::decay_t<Args>...>>();
+    std::apply([&](auto &... a) { (obj->*func)(a...); }, args);
+    return true;
+  }
+
+  template <typename, uint64_t>
+  struct inline_dispatcher;
+
+  template <typename T, uint64_t Name, typename... Args>
+  struct inline_dispatcher<void (T::*)(Args...), Name>
+  {
+    static void call(account_name code, const permission_level &perm, std::tuple<Args...> args)
+    {
+      action(perm, code, Name, std::move(args)).send();
+    }
+    static void call(account_name code, std::vector<permission_level> perms, std::tuple<Args...> args)
+    {
+      action(perms, code, Name, std::move(args)).send();
+    }
+  };
+}
+
+#define INLINE_ACTION_SENDER3(CONTRACT_CLASS, FUNCTION_NAME, ACTION_NAME) \
+  ::eosio::inline_dispatcher<decltype(&CONTRACT_CLASS::FUNCTION_NAME), ACTION_NAME>::call
+
+#define INLINE_ACTION_SENDER2(CONTRACT_CLASS, NAME) \
+  INLINE_ACTION_SENDER3(CONTRACT_CLASS, NAME, ::eosio::string_to_name(#NAME))
+
+#define INLINE_ACTION_SENDER(...) BOOST_PP_OVERLOAD(INLINE_ACTION_SENDER, __VA_ARGS__)(__VA_ARGS__)
+
+#define EOSIO_API_CALL(r, OP, elem)                           \
+  case ::eosio::string_to_name(BOOST_PP_STRINGIZE(elem)):     \
+    eosio::execute_action(&thiscontract, &OP::elem);          \
+    break;
+
+#define EOSIO_API(TYPE, MEMBERS) \
+  BOOST_PP_SEQ_FOR_EACH(EOSIO_API_CALL, TYPE, MEMBERS)
@@ -0,0 +1,12 @@
+/**
+ *  @file eosio.hpp
+ */
+#pragma once
+
+#include <eosiolib/types.hpp>
+#include <eosiolib/system.hpp>
+#include <eosiolib/print.hpp>
+#include <eosiolib/action.hpp>
+#include <eosiolib/contract.hpp>
+#include <eosiolib/dispatcher.hpp>
+#include <eosiolib/mock.hpp>
@@ -0,0 +1,221 @@
+/**
+ *  @file mock.hpp
+ *
+ *  In-memory chain state of the host build. State is thread local,
+ *  so independent chains could run on different threads.
+ *  Operations are counted the same way as the instrumentation build does,
+ *  see include/bankofstaked/profile.hpp.
+ */
+#pragma once
+
+#include <eosiolib/action.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <typeindex>
+
+// entry point of the contract built into the same binary
+extern "C" [[noreturn]] void apply(uint64_t receiver, uint64_t code, uint64_t action);
+
+namespace eosio
+{
+  namespace mock
+  {
+    struct counters
+    {
+      uint64_t finds;
+      uint64_t iterations;
+      uint64_t modifies;
+      uint64_t emplaces;
+      uint64_t erases;
+      uint64_t external_reads;
+      uint64_t inline_sends;
+      uint64_t deferred_sends;
+      uint64_t deferred_cancels;
+    };
+
+    struct deferred_transaction
+    {
+      uint128_t sender_id;
+      account_name payer;
+      uint32_t deliver_at; // unix time, in seconds
+      std::vector<action> actions;
+    };
+
+    struct chain
+    {
+      uint32_t time = 0;       // unix time, in seconds
+      account_name receiver = 0;
+      counters ops = {};
+      std::vector<char> data;              // data of action being applied
+      std::vector<action> inline_actions;  // sent by actions applied so far, in order
+      std::map<uint128_t, deferred_transaction> deferred;
+      std::set<std::pair<uint32_t, uint128_t>> schedule; // deferred transactions by deliver_at
+      // code, scope, table and row type. rows are stored typed, not serialized, so a table read
+      // through another struct, e.g. rows of an earlier layout being migrated, is kept apart
+      std::map<std::tuple<uint64_t, uint64_t, uint64_t, std::type_index>, std::shared_ptr<void>> tables;
+      bool journaling = false;                 // writes are recorded in undo while a transaction is applied
+      std::vector<std::function<void()>> undo; // reverts writes of transaction being applied, latest last
+    };
+
+    inline chain &current()
+    {
+      thread_local chain c;
+      return c;
+    }
+
+    inline const std::vector<char> &action_data()
+    {
+      return current().data;
+    }
+
+    //drop all tables, pending transactions and counters of this thread
+    inline void reset()
+    {
+      current() = chain();
+    }
+
+    inline bool journaling()
+    {
+      return current().journaling;
+    }
+
+    //record how to revert a write of the transaction being applied
+    template <typename Lambda>
+    void on_undo(Lambda &&revert)
+    {
+      chain &c = current();
+      if (c.journaling)
+      {
+        c.undo.emplace_back(std::forward<Lambda>(revert));
+      }
+    }
+
+    //writes from here on are reverted by rollback, until commit
+    inline void begin_transaction()
+    {
+      chain &c = current();
+      c.undo.clear();
+      c.journaling = true;
+    }
+
+    inline void commit()
+    {
+      chain &c = current();
+      c.undo.clear();
+      c.journaling = false;
+    }
+
+    //revert writes since begin_transaction, latest first
+    inline void rollback()
+    {
+      chain &c = current();
+      c.journaling = false;
+      while (!c.undo.empty())
+      {
+        auto revert = std::move(c.undo.back());
+        c.undo.pop_back();
+        revert();
+      }
+    }
+
+    inline void set_now(uint32_t time)
+    {
+      current().time = time;
+    }
+
+    //reads of tables owned by other contracts are external reads
+    inline void count_find(uint64_t code)
+    {
+      chain &c = current();
+      if (code == c.receiver)
+      {
+        c.ops.finds++;
+      }
+      else
+      {
+        c.ops.external_reads++;
+      }
+    }
+
+    //apply action of code on receiver, inline actions it sends are appended to inline_actions,
+    //mock::assertion is rethrown if it fails
+    inline void call(account_name receiver, account_name code, action_name act, std::vector<char> data)
+    {
+      chain &c = current();
+      struct restore
+      {
+        chain &c;
+        account_name receiver;
+        std::vector<char> data;
+        ~restore()
+        {
+          c.receiver = receiver;
+          c.data = std::move(data);
+        }
+      } r{c, c.receiver, std::move(c.data)};
+      c.receiver = receiver;
+      c.data = std::move(data);
+      try
+      {
+        ::apply(receiver, code, act);
+      }
+      catch (const exited &)
+      {
+      }
+    }
+
+    template <typename T>
+    void call(account_name receiver, account_name code, action_name act, const T &args)
+    {
+      call(receiver, code, act, pack(args));
+    }
+
+    //remove deferred transaction, returns true if it was pending
+    inline bool cancel(const uint128_t &sender_id)
+    {
+      chain &c = current();
+      auto itr = c.deferred.find(sender_id);
+      if (itr == c.deferred.end())
+      {
+        return false;
+      }
+      if (c.journaling)
+      {
+        on_undo([trx = itr->second] {
+          chain &c = current();
+          c.schedule.emplace(trx.deliver_at, trx.sender_id);
+          c.deferred.emplace(trx.sender_id, trx);
+        });
+      }
+      c.schedule.erase(std::make_pair(itr->second.deliver_at, sender_id));
+      c.deferred.erase(itr);
+      return true;
+    }
+  }
+
+  void action::send() const
+  {
+    mock::chain &c = mock::current();
+    c.ops.inline_sends++;
+    c.inline_actions.emplace_back(*this);
+  }
+}
+
+uint32_t now()
+{
+  return eosio::mock::current().time;
+}
+
+uint64_t current_time()
+{
+  return uint64_t(eosio::mock::current().time) * 1000000;
+}
+
+inline int cancel_deferred(const uint128_t &sender_id)
+{
+  eosio::mock::current().ops.deferred_cancels++;
+  return eosio::mock::cancel(sender_id);
+}
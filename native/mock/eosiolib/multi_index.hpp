@@ -0,0 +1,455 @@
+/**
+ *  @file multi_index.hpp
+ *
+ *  Tables are kept in ordered maps of mock chain state, secondary indices are ordered
+ *  by secondary key then primary key like on chain. Iterators stay valid until their row is erased.
+ *  Writes of a journaled transaction are recorded, see mock::rollback.
+ */
+#pragma once
+
+#include <eosiolib/mock.hpp>
+#include <iterator>
+#include <limits>
+
+namespace eosio
+{
+  template <uint64_t IndexName, typename Extractor>
+  struct indexed_by
+  {
+    static constexpr uint64_t index_name = IndexName;
+    typedef Extractor secondary_extractor_type;
+  };
+
+  template <class Class, typename Type, Type (Class::*PtrToMemberFunction)() const>
+  struct const_mem_fun
+  {
+    typedef typename std::remove_reference<Type>::type result_type;
+
+    result_type operator()(const Class &x) const
+    {
+      return (x.*PtrToMemberFunction)();
+    }
+  };
+
+  namespace mock
+  {
+    template <typename Key, typename T>
+    struct secondary_entry
+    {
+      Key key;
+      uint64_t primary;
+      const T *row;
+
+      friend bool operator<(const secondary_entry &a, const secondary_entry &b)
+      {
+        return a.key < b.key || (a.key == b.key && a.primary < b.primary);
+      }
+    };
+
+    template <typename T, typename... Indices>
+    struct table_storage
+    {
+      std::map<uint64_t, T> rows;
+      std::tuple<std::set<secondary_entry<typename Indices::secondary_extractor_type::result_type, T>>...> indices;
+    };
+  }
+
+  template <uint64_t TableName, typename T, typename... Indices>
+  class multi_index
+  {
+  private:
+    typedef mock::table_storage<T, Indices...> storage_type;
+    typedef std::map<uint64_t, T> rows_type;
+
+    template <size_t N>
+    using extractor = typename std::tuple_element<N, std::tuple<Indices...>>::type::secondary_extractor_type;
+
+    template <size_t N>
+    using entry = mock::secondary_entry<typename extractor<N>::result_type, T>;
+
+    uint64_t _code;
+    uint64_t _scope;
+    storage_type *_storage;
+
+    static storage_type *open(uint64_t code, uint64_t scope)
+    {
+      auto &tables = mock::current().tables;
+      auto key = std::make_tuple(code, scope, TableName, std::type_index(typeid(storage_type)));
+      auto itr = tables.find(key);
+      if (itr == tables.end())
+      {
+        itr = tables.emplace(key, std::make_shared<storage_type>()).first;
+      }
+      return static_cast<storage_type *>(itr->second.get());
+    }
+
+    template <size_t... N>
+    static auto secondary_keys(const T &row, std::index_sequence<N...>)
+    {
+      return std::make_tuple(extractor<N>()(row)...);
+    }
+
+    template <size_t... N>
+    static void insert_entries(storage_type &s, const T &row, uint64_t pk, std::index_sequence<N...>)
+    {
+      (void)row;
+      (void)pk;
+      (std::get<N>(s.indices).insert(entry<N>{extractor<N>()(row), pk, &row}), ...);
+    }
+
+    template <size_t... N>
+    static void erase_entries(storage_type &s, const T &row, uint64_t pk, std::index_sequence<N...>)
+    {
+      (void)row;
+      (void)pk;
+      (std::get<N>(s.indices).erase(entry<N>{extractor<N>()(row), pk, nullptr}), ...);
+    }
+
+    template <size_t N, typename Keys>
+    static void update_entry(storage_type &s, const T &row, uint64_t pk, const Keys &old_keys)
+    {
+      auto key = extractor<N>()(row);
+      if (key == std::get<N>(old_keys))
+      {
+        return;
+      }
+      auto &entries = std::get<N>(s.indices);
+      entries.erase(entry<N>{std::get<N>(old_keys), pk, nullptr});
+      entries.insert(entry<N>{key, pk, &row});
+      mock::current().ops.modifies++;
+    }
+
+    template <typename Keys, size_t... N>
+    static void update_entries(storage_type &s, const T &row, uint64_t pk, const Keys &old_keys, std::index_sequence<N...>)
+    {
+      (void)row;
+      (void)pk;
+      (void)old_keys;
+      (update_entry<N>(s, row, pk, old_keys), ...);
+    }
+
+    //put row back as it was before a write of the transaction being rolled back
+    static void restore_row(storage_type &s, uint64_t pk, const T *before)
+    {
+      auto itr = s.rows.find(pk);
+      if (itr != s.rows.end())
+      {
+        erase_entries(s, itr->second, pk, std::index_sequence_for<Indices...>());
+        s.rows.erase(itr);
+      }
+      if (before != nullptr)
+      {
+        auto result = s.rows.emplace(pk, *before);
+        insert_entries(s, result.first->second, pk, std::index_sequence_for<Indices...>());
+      }
+    }
+
+    static void record_undo(storage_type &s, uint64_t pk, const T *before)
+    {
+      if (!mock::journaling())
+      {
+        return;
+      }
+      if (before == nullptr)
+      {
+        mock::on_undo([&s, pk] { restore_row(s, pk, nullptr); });
+        return;
+      }
+      mock::on_undo([&s, pk, row = *before] { restore_row(s, pk, &row); });
+    }
+
+    template <typename Lambda>
+    static void modify_row(storage_type &s, const T &obj, Lambda &&updater)
+    {
+      T &row = const_cast<T &>(obj);
+      auto pk = row.primary_key();
+      record_undo(s, pk, &row);
+      auto old_keys = secondary_keys(row, std::index_sequence_for<Indices...>());
+      updater(row);
+      eosio_assert(pk == row.primary_key(), "updater cannot change primary key when modifying an object");
+      mock::current().ops.modifies++;
+      update_entries(s, row, pk, old_keys, std::index_sequence_for<Indices...>());
+    }
+
+    static void erase_row(storage_type &s, const T &obj)
+    {
+      uint64_t pk = obj.primary_key();
+      record_undo(s, pk, &obj);
+      erase_entries(s, obj, pk, std::index_sequence_for<Indices...>());
+      s.rows.erase(pk);
+      mock::current().ops.erases += 1 + sizeof...(Indices);
+    }
+
+    template <uint64_t IndexName>
+    static constexpr size_t index_position()
+    {
+      constexpr uint64_t names[] = {Indices::index_name..., 0};
+      for (size_t i = 0; i < sizeof...(Indices); i++)
+      {
+        if (names[i] == IndexName)
+        {
+          return i;
+        }
+      }
+      return sizeof...(Indices);
+    }
+
+  public:
+    struct const_iterator
+    {
+      typedef std::bidirectional_iterator_tag iterator_category;
+      typedef const T value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const T *pointer;
+      typedef const T &reference;
+
+      typename rows_type::const_iterator _itr;
+
+      const T &operator*() const { return _itr->second; }
+      const T *operator->() const { return &_itr->second; }
+
+      const_iterator &operator++()
+      {
+        mock::current().ops.iterations++;
+        ++_itr;
+        return *this;
+      }
+      const_iterator operator++(int)
+      {
+        const_iterator result = *this;
+        ++(*this);
+        return result;
+      }
+      const_iterator &operator--()
+      {
+        mock::current().ops.iterations++;
+        --_itr;
+        return *this;
+      }
+      const_iterator operator--(int)
+      {
+        const_iterator result = *this;
+        --(*this);
+        return result;
+      }
+
+      friend bool operator==(const const_iterator &a, const const_iterator &b) { return a._itr == b._itr; }
+      friend bool operator!=(const const_iterator &a, const const_iterator &b) { return a._itr != b._itr; }
+    };
+
+    template <uint64_t IndexName, typename Extractor, size_t N>
+    class index
+    {
+    private:
+      typedef typename Extractor::result_type key_type;
+      typedef mock::secondary_entry<key_type, T> entry_type;
+      typedef std::set<entry_type> entries_type;
+
+      uint64_t _code;
+      storage_type *_storage;
+
+      entries_type &entries() const { return std::get<N>(_storage->indices); }
+
+    public:
+      struct const_iterator
+      {
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef const T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T *pointer;
+        typedef const T &reference;
+
+        typename entries_type::const_iterator _itr;
+
+        const T &operator*() const { return *_itr->row; }
+        const T *operator->() const { return _itr->row; }
+
+        const_iterator &operator++()
+        {
+          mock::current().ops.iterations++;
+          ++_itr;
+          return *this;
+        }
+        const_iterator operator++(int)
+        {
+          const_iterator result = *this;
+          ++(*this);
+          return result;
+        }
+        const_iterator &operator--()
+        {
+          mock::current().ops.iterations++;
+          --_itr;
+          return *this;
+        }
+        const_iterator operator--(int)
+        {
+          const_iterator result = *this;
+          --(*this);
+          return result;
+        }
+
+        friend bool operator==(const const_iterator &a, const const_iterator &b) { return a._itr == b._itr; }
+        friend bool operator!=(const const_iterator &a, const const_iterator &b) { return a._itr != b._itr; }
+      };
+
+      index(uint64_t code, storage_type *storage) : _code(code), _storage(storage) {}
+
+      static constexpr uint64_t name() { return IndexName; }
+      uint64_t get_code() const { return _code; }
+
+      const_iterator begin() const
+      {
+        mock::count_find(_code);
+        return const_iterator{entries().begin()};
+      }
+      const_iterator end() const { return const_iterator{entries().end()}; }
+      const_iterator cbegin() const { return begin(); }
+      const_iterator cend() const { return end(); }
+
+      const_iterator lower_bound(key_type key) const
+      {
+        mock::count_find(_code);
+        return const_iterator{entries().lower_bound(entry_type{key, 0, nullptr})};
+      }
+
+      const_iterator upper_bound(key_type key) const
+      {
+        mock::count_find(_code);
+        return const_iterator{entries().upper_bound(entry_type{key, std::numeric_limits<uint64_t>::max(), nullptr})};
+      }
+
+      const_iterator find(key_type key) const
+      {
+        auto itr = lower_bound(key);
+        if (itr == end() || itr._itr->key != key)
+        {
+          return end();
+        }
+        return itr;
+      }
+
+      const T &get(key_type key, const char *error_msg = "unable to find secondary key") const
+      {
+        auto result = find(key);
+        eosio_assert(result != end(), error_msg);
+        return *result;
+      }
+
+      template <typename Lambda>
+      void modify(const_iterator itr, account_name payer, Lambda &&updater)
+      {
+        (void)payer;
+        eosio_assert(itr != end(), "cannot pass end iterator to modify");
+        multi_index::modify_row(*_storage, *itr, std::forward<Lambda>(updater));
+      }
+
+      const_iterator erase(const_iterator itr)
+      {
+        eosio_assert(itr != end(), "cannot pass end iterator to erase");
+        auto next = std::next(itr._itr);
+        multi_index::erase_row(*_storage, *itr);
+        return const_iterator{next};
+      }
+    };
+
+    multi_index(uint64_t code, uint64_t scope)
+        : _code(code), _scope(scope), _storage(open(code, scope)) {}
+
+    uint64_t get_code() const { return _code; }
+    uint64_t get_scope() const { return _scope; }
+
+    const_iterator begin() const
+    {
+      mock::count_find(_code);
+      return const_iterator{_storage->rows.cbegin()};
+    }
+    const_iterator end() const { return const_iterator{_storage->rows.cend()}; }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    const_iterator lower_bound(uint64_t primary) const
+    {
+      mock::count_find(_code);
+      return const_iterator{_storage->rows.lower_bound(primary)};
+    }
+
+    const_iterator upper_bound(uint64_t primary) const
+    {
+      mock::count_find(_code);
+      return const_iterator{_storage->rows.upper_bound(primary)};
+    }
+
+    const_iterator find(uint64_t primary) const
+    {
+      mock::count_find(_code);
+      return const_iterator{_storage->rows.find(primary)};
+    }
+
+    const T &get(uint64_t primary, const char *error_msg = "unable to find key") const
+    {
+      auto result = find(primary);
+      eosio_assert(result != end(), error_msg);
+      return *result;
+    }
+
+    uint64_t available_primary_key() const
+    {
+      if (_storage->rows.empty())
+      {
+        return 0;
+      }
+      return std::prev(_storage->rows.end())->first + 1;
+    }
+
+    template <uint64_t IndexName>
+    auto get_index() const
+    {
+      constexpr size_t position = index_position<IndexName>();
+      static_assert(position < sizeof...(Indices), "name provided is not the name of any secondary index within multi_index");
+      return index<IndexName, extractor<position>, position>(_code, _storage);
+    }
+
+    template <typename Lambda>
+    const_iterator emplace(account_name payer, Lambda &&constructor)
+    {
+      (void)payer;
+      T obj = T();
+      constructor(obj);
+      uint64_t pk = obj.primary_key();
+      auto result = _storage->rows.emplace(pk, std::move(obj));
+      eosio_assert(result.second, "could not insert object, most likely a uniqueness constraint was violated");
+      insert_entries(*_storage, result.first->second, pk, std::index_sequence_for<Indices...>());
+      record_undo(*_storage, pk, nullptr);
+      mock::current().ops.emplaces += 1 + sizeof...(Indices);
+      return const_iterator{result.first};
+    }
+
+    template <typename Lambda>
+    void modify(const_iterator itr, account_name payer, Lambda &&updater)
+    {
+      eosio_assert(itr != end(), "cannot pass end iterator to modify");
+      modify(*itr, payer, std::forward<Lambda>(updater));
+    }
+
+    template <typename Lambda>
+    void modify(const T &obj, account_name payer, Lambda &&updater)
+    {
+      (void)payer;
+      modify_row(*_storage, obj, std::forward<Lambda>(updater));
+    }
+
+    const_iterator erase(const_iterator itr)
+    {
+      eosio_assert(itr != end(), "cannot pass end iterator to erase");
+      auto next = std::next(itr._itr);
+      erase_row(*_storage, *itr);
+      return const_iterator{next};
+    }
+
+    void erase(const T &obj)
+    {
+      erase_row(*_storage, obj);
+    }
+  };
+}
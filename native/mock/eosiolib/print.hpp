@@ -0,0 +1,12 @@
+/**
+ *  @file print.hpp
+ *
+ *  Console output of actions is dropped in the host build.
+ */
+#pragma once
+
+namespace eosio
+{
+  template <typename... Args>
+  void print(Args &&...) {}
+}
@@ -0,0 +1,155 @@
+/**
+ *  @file serialize.hpp
+ *
+ *  Packing of action data, members are written back to back in declaration order.
+ *  Layout is only meant to round trip within the host build, it is NOT the chain's wire format.
+ */
+#pragma once
+
+#include <eosiolib/system.hpp>
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace eosio
+{
+  struct datastream_writer
+  {
+    std::vector<char> bytes;
+
+    void write(const void *data, size_t size)
+    {
+      const char *c = static_cast<const char *>(data);
+      bytes.insert(bytes.end(), c, c + size);
+    }
+  };
+
+  struct datastream_reader
+  {
+    const char *pos;
+    const char *end;
+
+    void read(void *data, size_t size)
+    {
+      eosio_assert(size <= size_t(end - pos), "read");
+      std::memcpy(data, pos, size);
+      pos += size;
+    }
+  };
+
+  template <typename T>
+  std::enable_if_t<std::is_arithmetic<T>::value, datastream_writer &> operator<<(datastream_writer &ds, const T &v)
+  {
+    ds.write(&v, sizeof(v));
+    return ds;
+  }
+
+  template <typename T>
+  std::enable_if_t<std::is_arithmetic<T>::value, datastream_reader &> operator>>(datastream_reader &ds, T &v)
+  {
+    ds.read(&v, sizeof(v));
+    return ds;
+  }
+
+  inline datastream_writer &operator<<(datastream_writer &ds, const uint128_t &v)
+  {
+    ds.write(&v, sizeof(v));
+    return ds;
+  }
+
+  inline datastream_reader &operator>>(datastream_reader &ds, uint128_t &v)
+  {
+    ds.read(&v, sizeof(v));
+    return ds;
+  }
+
+  inline datastream_writer &operator<<(datastream_writer &ds, const std::string &v)
+  {
+    ds << uint32_t(v.size());
+    ds.write(v.data(), v.size());
+    return ds;
+  }
+
+  inline datastream_reader &operator>>(datastream_reader &ds, std::string &v)
+  {
+    uint32_t size = 0;
+    ds >> size;
+    v.resize(size);
+    ds.read(&v[0], size);
+    return ds;
+  }
+
+  template <typename T>
+  datastream_writer &operator<<(datastream_writer &ds, const std::vector<T> &v)
+  {
+    ds << uint32_t(v.size());
+    for (const auto &i : v)
+    {
+      ds << i;
+    }
+    return ds;
+  }
+
+  template <typename T>
+  datastream_reader &operator>>(datastream_reader &ds, std::vector<T> &v)
+  {
+    uint32_t size = 0;
+    ds >> size;
+    v.resize(size);
+    for (auto &i : v)
+    {
+      ds >> i;
+    }
+    return ds;
+  }
+
+  template <typename... Args>
+  datastream_writer &operator<<(datastream_writer &ds, const std::tuple<Args...> &t)
+  {
+    std::apply([&](const auto &... i) { (void)(ds << ... << i); }, t);
+    return ds;
+  }
+
+  template <typename... Args>
+  datastream_reader &operator>>(datastream_reader &ds, std::tuple<Args...> &t)
+  {
+    std::apply([&](auto &... i) { (void)(ds >> ... >> i); }, t);
+    return ds;
+  }
+
+  template <typename T>
+  std::vector<char> pack(const T &value)
+  {
+    datastream_writer ds;
+    ds << value;
+    return std::move(ds.bytes);
+  }
+
+  template <typename T>
+  T unpack(const std::vector<char> &bytes)
+  {
+    T value;
+    datastream_reader ds{bytes.data(), bytes.data() + bytes.size()};
+    ds >> value;
+    return value;
+  }
+}
+
+#define EOSLIB_REFLECT_MEMBER_OP(r, OP, elem) \
+  OP t.elem
+
+#define EOSLIB_SERIALIZE(TYPE, MEMBERS)                                     \
+  template <typename DataStream>                                            \
+  friend DataStream &operator<<(DataStream &ds, const TYPE &t)              \
+  {                                                                         \
+    return ds BOOST_PP_SEQ_FOR_EACH(EOSLIB_REFLECT_MEMBER_OP, <<, MEMBERS); \
+  }                                                                         \
+  template <typename DataStream>                                            \
+  friend DataStream &operator>>(DataStream &ds, TYPE &t)                    \
+  {                                                                         \
+    return ds BOOST_PP_SEQ_FOR_EACH(EOSLIB_REFLECT_MEMBER_OP, >>, MEMBERS); \
+  }
@@ -0,0 +1,45 @@
+/**
+ *  @file system.hpp
+ *
+ *  Failed assertions throw instead of aborting the transaction,
+ *  eosio_exit unwinds back to the caller of apply.
+ */
+#pragma once
+
+#include <eosiolib/types.hpp>
+#include <stdexcept>
+
+namespace eosio
+{
+  namespace mock
+  {
+    // eosio_assert failed, state written before it is only rolled back inside a journaled transaction
+    struct assertion : std::runtime_error
+    {
+      using std::runtime_error::runtime_error;
+    };
+
+    // eosio_exit called
+    struct exited
+    {
+      int32_t code;
+    };
+  }
+}
+
+inline void eosio_assert(uint32_t test, const char *msg)
+{
+  if (!test)
+  {
+    throw eosio::mock::assertion(msg);
+  }
+}
+
+[[noreturn]] inline void eosio_exit(int32_t code)
+{
+  throw eosio::mock::exited{code};
+}
+
+// mock clock, see eosiolib/mock.hpp
+inline uint32_t now();
+inline uint64_t current_time();
@@ -0,0 +1,53 @@
+/**
+ *  @file transaction.hpp
+ *
+ *  Deferred transactions are kept in mock chain state until they are delivered by the host.
+ */
+#pragma once
+
+#include <eosiolib/mock.hpp>
+
+namespace eosio
+{
+  static const uint32_t MAX_TRANSACTION_DELAY = 45 * 24 * 3600; // max_transaction_delay of eosio default chain config
+
+  class transaction_header
+  {
+  public:
+    transaction_header(uint32_t exp = now() + 60)
+        : expiration(exp) {}
+
+    uint32_t expiration;
+    uint16_t ref_block_num = 0;
+    uint32_t ref_block_prefix = 0;
+    uint32_t max_net_usage_words = 0;
+    uint8_t max_cpu_usage_ms = 0;
+    uint32_t delay_sec = 0;
+  };
+
+  class transaction : public transaction_header
+  {
+  public:
+    transaction(uint32_t exp = now() + 60) : transaction_header(exp) {}
+
+    void send(const uint128_t &sender_id, account_name payer, bool replace_existing = false) const
+    {
+      mock::chain &c = mock::current();
+      eosio_assert(delay_sec <= MAX_TRANSACTION_DELAY, "transaction delay exceeds max_transaction_delay");
+      c.ops.deferred_sends++;
+      auto itr = c.deferred.find(sender_id);
+      if (itr != c.deferred.end())
+      {
+        eosio_assert(replace_existing, "deferred transaction with the same sender_id and payer already exists");
+        mock::cancel(sender_id);
+      }
+      mock::deferred_transaction trx{sender_id, payer, now() + delay_sec, actions};
+      c.schedule.emplace(trx.deliver_at, sender_id);
+      c.deferred.emplace(sender_id, std::move(trx));
+      mock::on_undo([sender_id] { mock::cancel(sender_id); });
+    }
+
+    std::vector<action> context_free_actions;
+    std::vector<action> actions;
+  };
+}
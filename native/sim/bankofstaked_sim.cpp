@@ -0,0 +1,471 @@
+/**
+ *  @file bankofstaked_sim.cpp
+ *
+ *  Offline simulator of expiry and rotation policies. A purchase stream, synthetic or
+ *  recorded, is replayed against every combination of swept parameters,
+ *  each combination runs on a chain of its own on a thread pool.
+ *
+ *    bankofstaked_sim --days=14 --orders=1000000 --max-batch=3,10,50 --paid-creditors=5,20
+ *
+ *  Report has three CSV sections: summary of each combination, operations per action
+ *  and failed purchases grouped by assertion message.
+ */
+#include <contracts.hpp>
+#include <fixture.hpp>
+#include <snapshot.hpp>
+#include <sim/node.hpp>
+#include <sim/thread_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace
+{
+  const uint64_t DAY_PRICE = 5000; // 0.5 EOS, 5 EOS cpu and 0.5 EOS net for a day
+
+  struct purchase
+  {
+    uint32_t at; // seconds since simulation starts
+    account_name from;
+    int64_t amount;
+    std::string memo;
+  };
+
+  struct params
+  {
+    uint64_t free_shards;
+    uint64_t paid_shards;
+    uint64_t rotate_depth;
+    uint64_t high_watermark;
+    uint64_t lag_threshold;
+    uint64_t max_batch;
+    uint64_t free_creditors;
+    uint64_t paid_creditors;
+    uint64_t creditor_balance; // EOS each creditor starts with
+    uint64_t creditor_ram;     // KB of RAM each creditor owns, 0 for no userres entry
+  };
+
+  struct utilization
+  {
+    double sum;
+    double peak;
+    uint64_t samples;
+
+    void add(double value)
+    {
+      sum += value;
+      peak = std::max(peak, value);
+      samples++;
+    }
+    double avg() const { return samples > 0 ? sum / samples : 0; }
+  };
+
+  struct report
+  {
+    params p;
+    uint64_t purchases;
+    uint64_t failed;
+    uint64_t live_orders;
+    uint64_t max_backlog;
+    uint64_t max_lag;
+    uint64_t rotations;
+    utilization free_util;
+    utilization paid_util;
+    double seconds;
+    std::map<action_name, sim::action_stats> actions;
+    std::map<std::string, uint64_t> failures;
+  };
+
+  struct options
+  {
+    uint64_t days = 14;
+    uint64_t orders = 100000;
+    uint64_t accounts = 20000;
+    double free_ratio = 0.3;
+    double day_ratio = 0.3; // share of day plan among paid purchases
+    uint64_t seed = 1;
+    uint64_t sample_interval = 3600;
+    uint64_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string stream;
+    std::string report;
+    std::string snapshot; // contract tables at the end, suffixed by job when sweeping
+    std::vector<uint64_t> free_shards{DEFAULT_FREE_SHARDS};
+    std::vector<uint64_t> paid_shards{DEFAULT_PAID_SHARDS};
+    std::vector<uint64_t> rotate_depth{DEFAULT_ROTATE_DEPTH};
+    std::vector<uint64_t> high_watermark{DEFAULT_HIGH_WATERMARK};
+    std::vector<uint64_t> lag_threshold{DEFAULT_LAG_THRESHOLD};
+    std::vector<uint64_t> max_batch{DEFAULT_MAX_EXPIRY_BATCH};
+    std::vector<uint64_t> free_creditors{2};
+    std::vector<uint64_t> paid_creditors{4};
+    std::vector<uint64_t> creditor_balance{100000};
+    std::vector<uint64_t> creditor_ram{0};
+  };
+
+  std::vector<uint64_t> parse_list(const std::string &value)
+  {
+    std::vector<uint64_t> list;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+      list.emplace_back(std::stoull(item));
+    }
+    eosio_assert(list.size() > 0, "empty list");
+    return list;
+  }
+
+  options parse_options(int argc, char **argv)
+  {
+    options o;
+    for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      size_t eq = arg.find('=');
+      eosio_assert(arg.compare(0, 2, "--") == 0 && eq != std::string::npos, ("expected --name=value, got " + arg).c_str());
+      std::string name = arg.substr(2, eq - 2);
+      std::string value = arg.substr(eq + 1);
+      if (name == "days") o.days = std::stoull(value);
+      else if (name == "orders") o.orders = std::stoull(value);
+      else if (name == "accounts") o.accounts = std::stoull(value);
+      else if (name == "free-ratio") o.free_ratio = std::stod(value);
+      else if (name == "day-ratio") o.day_ratio = std::stod(value);
+      else if (name == "seed") o.seed = std::stoull(value);
+      else if (name == "sample-interval") o.sample_interval = std::stoull(value);
+      else if (name == "threads") o.threads = std::stoull(value);
+      else if (name == "stream") o.stream = value;
+      else if (name == "report") o.report = value;
+      else if (name == "snapshot") o.snapshot = value;
+      else if (name == "free-shards") o.free_shards = parse_list(value);
+      else if (name == "paid-shards") o.paid_shards = parse_list(value);
+      else if (name == "rotate-depth") o.rotate_depth = parse_list(value);
+      else if (name == "high-watermark") o.high_watermark = parse_list(value);
+      else if (name == "lag-threshold") o.lag_threshold = parse_list(value);
+      else if (name == "max-batch") o.max_batch = parse_list(value);
+      else if (name == "free-creditors") o.free_creditors = parse_list(value);
+      else if (name == "paid-creditors") o.paid_creditors = parse_list(value);
+      else if (name == "creditor-balance") o.creditor_balance = parse_list(value);
+      else if (name == "creditor-ram") o.creditor_ram = parse_list(value);
+      else eosio_assert(false, ("unknown option --" + name).c_str());
+    }
+    eosio_assert(o.days > 0 && o.accounts > 0 && o.sample_interval > 0 && o.threads > 0, "days, accounts, sample-interval and threads should be positive");
+    return o;
+  }
+
+  //purchases evenly spread over days by accounts picked at random, plans mixed by ratio
+  std::vector<purchase> synthetic_stream(const options &o)
+  {
+    std::mt19937_64 rng(o.seed);
+    std::uniform_int_distribution<uint32_t> at(0, o.days * SECONDS_PER_DAY - 1);
+    std::uniform_int_distribution<uint64_t> who(0, o.accounts - 1);
+    std::uniform_real_distribution<double> kind(0, 1);
+    std::vector<purchase> stream;
+    stream.reserve(o.orders);
+    for (uint64_t i = 0; i < o.orders; i++)
+    {
+      purchase p;
+      p.at = at(rng);
+      p.from = fixture::account("b", who(rng));
+      if (kind(rng) < o.free_ratio)
+      {
+        p.amount = fixture::FREE_PRICE;
+      }
+      else
+      {
+        p.amount = kind(rng) < o.day_ratio ? DAY_PRICE : fixture::PAID_PRICE;
+      }
+      stream.emplace_back(p);
+    }
+    std::sort(stream.begin(), stream.end(), [](const purchase &a, const purchase &b) { return a.at < b.at; });
+    return stream;
+  }
+
+  //recorded purchases, one `at,from,amount[,memo]` line each, amount in 0.0001 EOS
+  std::vector<purchase> recorded_stream(const std::string &path)
+  {
+    std::ifstream in(path);
+    eosio_assert(in.good(), ("cannot open " + path).c_str());
+    std::vector<purchase> stream;
+    std::string line;
+    while (std::getline(in, line))
+    {
+      if (line.empty() || line[0] == '#')
+      {
+        continue;
+      }
+      std::stringstream ss(line);
+      std::string at, from, amount, memo;
+      std::getline(ss, at, ',');
+      std::getline(ss, from, ',');
+      std::getline(ss, amount, ',');
+      std::getline(ss, memo);
+      stream.push_back(purchase{uint32_t(std::stoul(at)), string_to_name(from.c_str()), std::stoll(amount), memo});
+    }
+    std::stable_sort(stream.begin(), stream.end(), [](const purchase &a, const purchase &b) { return a.at < b.at; });
+    return stream;
+  }
+
+  std::vector<params> sweep(const options &o)
+  {
+    std::vector<params> combinations;
+    for (auto free_shards : o.free_shards)
+    for (auto paid_shards : o.paid_shards)
+    for (auto rotate_depth : o.rotate_depth)
+    for (auto high_watermark : o.high_watermark)
+    for (auto lag_threshold : o.lag_threshold)
+    for (auto max_batch : o.max_batch)
+    for (auto free_creditors : o.free_creditors)
+    for (auto paid_creditors : o.paid_creditors)
+    for (auto creditor_balance : o.creditor_balance)
+    for (auto creditor_ram : o.creditor_ram)
+    {
+      combinations.push_back(params{free_shards, paid_shards, rotate_depth, high_watermark, lag_threshold,
+                                    max_batch, free_creditors, paid_creditors, creditor_balance, creditor_ram});
+    }
+    return combinations;
+  }
+
+  //share of creditor funds staked for orders, funds being refunded included
+  void sample_utilization(const sim::node &node, report &r)
+  {
+    double staked[2] = {0, 0};
+    double total[2] = {0, 0};
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    for (const auto &creditor : c)
+    {
+      double s = (creditor.cpu_staked + creditor.net_staked).amount;
+      staked[creditor.for_free] += s;
+      total[creditor.for_free] += s + get_balance(creditor.account).amount + node.refunding(creditor.account);
+    }
+    if (total[TRUE] > 0)
+    {
+      r.free_util.add(staked[TRUE] / total[TRUE]);
+    }
+    if (total[FALSE] > 0)
+    {
+      r.paid_util.add(staked[FALSE] / total[FALSE]);
+    }
+    r.max_backlog = std::max(r.max_backlog, get_expirystat().backlog);
+  }
+
+  //replay stream on a fresh chain of the calling thread
+  //tables of bankofstaked in portable snapshot layout, see bankofstaked_export
+  void write_snapshot(const std::string &path)
+  {
+    snapshot::writer w(path);
+    plan_table plans(ADMIN_ACCOUNT, ADMIN_ACCOUNT);
+    w.add_table(plans, N(plan), ADMIN_RAM_PAYER);
+    creditor_table creditors(CODE_ACCOUNT, SCOPE);
+    w.add_table(creditors, N(creditor), RAM_PAYER);
+    history_table history(CODE_ACCOUNT, SCOPE);
+    w.add_table(history, N(history), RAM_PAYER);
+    freelock_table freelocks(CODE_ACCOUNT, SCOPE);
+    w.add_table(freelocks, N(freelock), RAM_PAYER);
+    refunding_table refundings(CODE_ACCOUNT, SCOPE);
+    w.add_table(refundings, N(refunding), RAM_PAYER);
+    for (uint64_t partition : get_orderdir().partitions)
+    {
+      order_table orders(CODE_ACCOUNT, get_partition_scope(partition));
+      w.add_table(orders, N(order), RAM_PAYER);
+    }
+  }
+
+  report simulate(const params &p, const std::vector<purchase> &stream, const options &o, const std::string &snapshot_path)
+  {
+    auto started = std::chrono::steady_clock::now();
+    report r = report();
+    r.p = p;
+
+    mock::reset();
+    mock::set_now(fixture::GENESIS);
+    fixture::setup_plans();
+    fixture::setplan(asset(DAY_PRICE, EOS_SYMBOL), asset(50000, EOS_SYMBOL), asset(5000, EOS_SYMBOL), 24 * 60, false);
+    fixture::admin(N(setconfig), pack(std::make_tuple(p.free_shards, p.paid_shards, p.rotate_depth,
+                                                      p.high_watermark, p.lag_threshold, p.max_batch)));
+    for (uint64_t i = 0; i < p.paid_creditors; i++)
+    {
+      fixture::addcreditor(fixture::account("paid", i), false, asset(p.creditor_balance * 10000, EOS_SYMBOL), p.creditor_ram * 1024);
+      if (i < p.paid_shards)
+      {
+        fixture::activate(fixture::account("paid", i));
+      }
+    }
+    for (uint64_t i = 0; i < p.free_creditors; i++)
+    {
+      fixture::addcreditor(fixture::account("free", i), true, asset(p.creditor_balance * 10000, EOS_SYMBOL), p.creditor_ram * 1024);
+      if (i < p.free_shards)
+      {
+        fixture::activate(fixture::account("free", i));
+      }
+    }
+    fixture::clear();
+
+    sim::node node;
+    uint32_t end = fixture::GENESIS + o.days * SECONDS_PER_DAY;
+    uint32_t next_sample = fixture::GENESIS;
+    uint32_t next_clear = fixture::GENESIS + SECONDS_PER_DAY;
+    action clearhistory(permission_level{CODE_ACCOUNT, N(active)}, CODE_ACCOUNT, N(clearhistory),
+                        std::make_tuple(~uint64_t(0)));
+    action sweeplocks(permission_level{CODE_ACCOUNT, N(active)}, CODE_ACCOUNT, N(sweeplocks),
+                      std::make_tuple(~uint64_t(0)));
+    auto until = [&](uint32_t time) {
+      while (next_sample <= time || next_clear <= time)
+      {
+        if (next_sample <= next_clear)
+        {
+          node.advance(next_sample);
+          sample_utilization(node, r);
+          next_sample += o.sample_interval;
+        }
+        else
+        {
+          // history and freelocks of past days are pruned daily, they only grow otherwise
+          node.advance(next_clear);
+          node.push_transaction({clearhistory, sweeplocks});
+          next_clear += SECONDS_PER_DAY;
+        }
+      }
+      node.advance(time);
+    };
+
+    for (const auto &purchase : stream)
+    {
+      until(fixture::GENESIS + purchase.at);
+      r.purchases++;
+      if (!node.push_transfer(purchase.from, CODE_ACCOUNT, asset(purchase.amount, EOS_SYMBOL), purchase.memo))
+      {
+        r.failed++;
+      }
+    }
+    until(std::max(end, uint32_t(now())));
+
+    for (uint64_t partition : get_orderdir().partitions)
+    {
+      order_table orders(CODE_ACCOUNT, get_partition_scope(partition));
+      for (auto itr = orders.begin(); itr != orders.end(); itr++)
+      {
+        r.live_orders++;
+      }
+    }
+    r.max_lag = get_expirystat().max_lag;
+    r.rotations = get_metrics().rotations;
+    r.actions = node.stats;
+    r.failures = node.failures;
+    if (!snapshot_path.empty())
+    {
+      write_snapshot(snapshot_path);
+    }
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    mock::reset();
+    return r;
+  }
+
+  double per_call(uint64_t value, uint64_t calls)
+  {
+    return calls > 0 ? double(value) / calls : 0;
+  }
+
+  void write_report(std::ostream &out, const std::vector<report> &reports)
+  {
+    out << "# summary\n"
+        << "job,free_shards,paid_shards,rotate_depth,high_watermark,lag_threshold,max_batch,"
+        << "free_creditors,paid_creditors,creditor_balance,creditor_ram,purchases,failed,live_orders,max_backlog,max_lag,"
+        << "rotations,free_util_avg,free_util_peak,paid_util_avg,paid_util_peak,seconds\n";
+    for (size_t i = 0; i < reports.size(); i++)
+    {
+      const report &r = reports[i];
+      out << i << "," << r.p.free_shards << "," << r.p.paid_shards << "," << r.p.rotate_depth << ","
+          << r.p.high_watermark << "," << r.p.lag_threshold << "," << r.p.max_batch << ","
+          << r.p.free_creditors << "," << r.p.paid_creditors << "," << r.p.creditor_balance << ","
+          << r.p.creditor_ram << ","
+          << r.purchases << "," << r.failed << "," << r.live_orders << "," << r.max_backlog << ","
+          << r.max_lag << "," << r.rotations << ","
+          << r.free_util.avg() << "," << r.free_util.peak << ","
+          << r.paid_util.avg() << "," << r.paid_util.peak << "," << r.seconds << "\n";
+    }
+
+    // average per call
+    out << "\n# actions\n"
+        << "job,action,calls,failures,finds,iterations,writes,external_reads,inline_sends,deferred_sends,deferred_cancels\n";
+    for (size_t i = 0; i < reports.size(); i++)
+    {
+      for (const auto &a : reports[i].actions)
+      {
+        const sim::action_stats &s = a.second;
+        out << i << "," << name{a.first}.to_string() << "," << s.calls << "," << s.failures << ","
+            << per_call(s.ops.finds, s.calls) << "," << per_call(s.ops.iterations, s.calls) << ","
+            << per_call(s.ops.modifies + s.ops.emplaces + s.ops.erases, s.calls) << ","
+            << per_call(s.ops.external_reads, s.calls) << "," << per_call(s.ops.inline_sends, s.calls) << ","
+            << per_call(s.ops.deferred_sends, s.calls) << "," << per_call(s.ops.deferred_cancels, s.calls) << "\n";
+      }
+    }
+
+    out << "\n# failures\n"
+        << "job,count,reason\n";
+    for (size_t i = 0; i < reports.size(); i++)
+    {
+      for (const auto &f : reports[i].failures)
+      {
+        out << i << "," << f.second << ",\"" << f.first << "\"\n";
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  try
+  {
+    options o = parse_options(argc, argv);
+    const std::vector<purchase> stream = o.stream.empty() ? synthetic_stream(o) : recorded_stream(o.stream);
+    std::vector<params> combinations = sweep(o);
+    std::vector<report> reports(combinations.size());
+    std::cerr << combinations.size() << " combinations, " << stream.size() << " purchases, "
+              << o.threads << " threads" << std::endl;
+    {
+      sim::thread_pool pool(std::min<uint64_t>(o.threads, combinations.size()));
+      std::mutex progress;
+      for (size_t i = 0; i < combinations.size(); i++)
+      {
+        pool.submit([&, i] {
+          try
+          {
+            std::string snapshot_path = o.snapshot;
+            if (!snapshot_path.empty() && combinations.size() > 1)
+            {
+              snapshot_path += "." + std::to_string(i);
+            }
+            reports[i] = simulate(combinations[i], stream, o, snapshot_path);
+          }
+          catch (const mock::assertion &e)
+          {
+            // setup failed, e.g. invalid config
+            reports[i].p = combinations[i];
+            reports[i].failures[std::string("setup: ") + e.what()]++;
+          }
+          std::lock_guard<std::mutex> lock(progress);
+          std::cerr << "job " << i << " done in " << reports[i].seconds << "s" << std::endl;
+        });
+      }
+    }
+
+    if (o.report.empty())
+    {
+      write_report(std::cout, reports);
+    }
+    else
+    {
+      std::ofstream out(o.report);
+      write_report(out, reports);
+    }
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,277 @@
+/**
+ *  @file node.hpp
+ *
+ *  Executes transactions against mock chain state of current thread.
+ *  Inline actions run after the action sending them, deferred transactions are
+ *  delivered in deliver_at order. eosio and eosio.token are modeled just enough
+ *  for creditor balances: delegatebw debits them, undelegatebw adds to the refunds row of owner
+ *  and restarts its REFUND_DELAY, after which the row is credited back like eosio 1.1 does,
+ *  refund credits it once mature, transfers move tokens between accounts having a balance entry.
+ *  Transfers and delegations of 0 are rejected like eosio.token and eosio do.
+ *  A failed transaction is rolled back like on chain, its table writes, deferred transactions
+ *  and refunds are reverted.
+ */
+#pragma once
+
+namespace sim
+{
+  struct action_stats
+  {
+    uint64_t calls;
+    uint64_t failures;
+    mock::counters ops; // summed over calls
+  };
+
+  inline void add_ops(mock::counters &sum, const mock::counters &after, const mock::counters &before)
+  {
+    sum.finds += after.finds - before.finds;
+    sum.iterations += after.iterations - before.iterations;
+    sum.modifies += after.modifies - before.modifies;
+    sum.emplaces += after.emplaces - before.emplaces;
+    sum.erases += after.erases - before.erases;
+    sum.external_reads += after.external_reads - before.external_reads;
+    sum.inline_sends += after.inline_sends - before.inline_sends;
+    sum.deferred_sends += after.deferred_sends - before.deferred_sends;
+    sum.deferred_cancels += after.deferred_cancels - before.deferred_cancels;
+  }
+
+  class node
+  {
+  public:
+    std::map<action_name, action_stats> stats; // bankofstaked actions, transfer notifications included
+    std::map<std::string, uint64_t> failures;  // assertion messages of failed transactions
+
+    //apply actions and inline actions they send as one transaction, nothing is kept if it fails
+    bool push_transaction(const std::vector<action> &actions)
+    {
+      mock::begin_transaction();
+      try
+      {
+        for (const auto &act : actions)
+        {
+          execute(act);
+        }
+      }
+      catch (const mock::assertion &e)
+      {
+        failures[e.what()]++;
+        mock::current().inline_actions.clear();
+        mock::rollback();
+        return false;
+      }
+      mock::commit();
+      return true;
+    }
+
+    bool push_transfer(account_name from, account_name to, asset quantity, const std::string &memo)
+    {
+      action act(permission_level{from, N(active)}, N(eosio.token), N(transfer),
+                 currency::transfer{from, to, quantity, memo});
+      return push_transaction({act});
+    }
+
+    //deliver refunds and deferred transactions due until time, then move clock to time
+    void advance(uint32_t time)
+    {
+      mock::chain &c = mock::current();
+      while (true)
+      {
+        bool has_refund = !refunds.empty() && refunds.begin()->first <= time;
+        bool has_deferred = !c.schedule.empty() && c.schedule.begin()->first <= time;
+        if (!has_refund && !has_deferred)
+        {
+          break;
+        }
+        if (has_refund && (!has_deferred || refunds.begin()->first <= c.schedule.begin()->first))
+        {
+          auto itr = refunds.begin();
+          tick(itr->first);
+          refund(*itr->second.begin());
+          continue;
+        }
+        uint128_t sender_id = c.schedule.begin()->second;
+        auto trx = c.deferred.find(sender_id);
+        tick(trx->second.deliver_at);
+        std::vector<action> actions = std::move(trx->second.actions);
+        mock::cancel(sender_id);
+        push_transaction(actions);
+      }
+      tick(time);
+    }
+
+    //EOS being refunded to account
+    int64_t refunding(account_name account) const
+    {
+      refundreq_table q(EOSIO, account);
+      auto itr = q.find(account);
+      return itr == q.end() ? 0 : (itr->net_amount + itr->cpu_amount).amount;
+    }
+
+  private:
+    std::map<uint32_t, std::set<account_name>> refunds; // due time, accounts
+
+    static void tick(uint32_t time)
+    {
+      if (time > now())
+      {
+        mock::set_now(time);
+      }
+    }
+
+    //accounts without balance entry, e.g. buyers, are not tracked
+    static void add_balance(account_name owner, int64_t amount)
+    {
+      eosio::token::accounts accountstable(N(eosio.token), owner);
+      auto itr = accountstable.find(symbol_type(EOS_SYMBOL).name());
+      if (itr == accountstable.end())
+      {
+        return;
+      }
+      eosio_assert(itr->balance.amount + amount >= 0, "overdrawn balance");
+      accountstable.modify(itr, owner, [&](auto &a) {
+        a.balance.amount += amount;
+      });
+    }
+
+    void execute(const action &act)
+    {
+      dispatch(act);
+      std::vector<action> sent;
+      sent.swap(mock::current().inline_actions);
+      for (const auto &a : sent)
+      {
+        execute(a);
+      }
+    }
+
+    void dispatch(const action &act)
+    {
+      if (act.account == CODE_ACCOUNT)
+      {
+        apply_contract(CODE_ACCOUNT, act);
+        return;
+      }
+      if (act.account == N(eosio.token) && act.name == N(transfer))
+      {
+        auto t = unpack<currency::transfer>(act.data);
+        eosio_assert(t.quantity.amount > 0, "must transfer positive quantity");
+        add_balance(t.from, -t.quantity.amount);
+        add_balance(t.to, t.quantity.amount);
+        if (t.to == CODE_ACCOUNT)
+        {
+          apply_contract(N(eosio.token), act);
+        }
+        return;
+      }
+      if (act.account == N(eosio) && act.name == N(delegatebw))
+      {
+        auto args = unpack<std::tuple<account_name, account_name, asset, asset, bool>>(act.data);
+        eosio_assert((std::get<2>(args) + std::get<3>(args)).amount > 0, "must stake a positive amount");
+        add_balance(std::get<0>(args), -(std::get<2>(args) + std::get<3>(args)).amount);
+        return;
+      }
+      // delegatebw of safedelegatebw deployed on creditor
+      if (act.name == N(delegatebw))
+      {
+        auto args = unpack<std::tuple<account_name, asset, asset>>(act.data);
+        eosio_assert((std::get<1>(args) + std::get<2>(args)).amount > 0, "must stake a positive amount");
+        add_balance(act.account, -(std::get<1>(args) + std::get<2>(args)).amount);
+        return;
+      }
+      if (act.account == N(eosio) && act.name == N(undelegatebw))
+      {
+        auto args = unpack<std::tuple<account_name, account_name, asset, asset>>(act.data);
+        undelegate(std::get<0>(args), std::get<2>(args), std::get<3>(args));
+        return;
+      }
+      if (act.account == N(eosio) && act.name == N(refund))
+      {
+        auto owner = unpack<std::tuple<account_name>>(act.data);
+        refundreq_table q(EOSIO, std::get<0>(owner));
+        auto itr = q.find(std::get<0>(owner));
+        eosio_assert(itr != q.end(), "refund request not found");
+        eosio_assert(itr->request_time + REFUND_DELAY <= now(), "refund is not available yet");
+        refund(std::get<0>(owner));
+        return;
+      }
+    }
+
+    //one refund request for each owner, undelegatebw adds to it and restarts its delay
+    void undelegate(account_name owner, asset net, asset cpu)
+    {
+      refundreq_table q(EOSIO, owner);
+      auto itr = q.find(owner);
+      if (itr == q.end())
+      {
+        q.emplace(owner, [&](auto &r) {
+          r.owner = owner;
+          r.request_time = now();
+          r.net_amount = net;
+          r.cpu_amount = cpu;
+        });
+      }
+      else
+      {
+        unschedule(owner, itr->request_time + REFUND_DELAY);
+        q.modify(itr, owner, [&](auto &r) {
+          r.request_time = now();
+          r.net_amount += net;
+          r.cpu_amount += cpu;
+        });
+      }
+      schedule(owner, now() + REFUND_DELAY);
+    }
+
+    void schedule(account_name owner, uint32_t time)
+    {
+      refunds[time].insert(owner);
+      mock::on_undo([this, owner, time] { unschedule(owner, time); });
+    }
+
+    void unschedule(account_name owner, uint32_t time)
+    {
+      auto due = refunds.find(time);
+      if (due == refunds.end() || due->second.erase(owner) == 0)
+      {
+        return;
+      }
+      if (due->second.empty())
+      {
+        refunds.erase(due);
+      }
+      mock::on_undo([this, owner, time] { refunds[time].insert(owner); });
+    }
+
+    //credit refund request of owner back to its balance
+    void refund(account_name owner)
+    {
+      refundreq_table q(EOSIO, owner);
+      auto itr = q.find(owner);
+      if (itr == q.end())
+      {
+        return;
+      }
+      unschedule(owner, itr->request_time + REFUND_DELAY);
+      add_balance(owner, (itr->net_amount + itr->cpu_amount).amount);
+      q.erase(itr);
+    }
+
+    void apply_contract(account_name code, const action &act)
+    {
+      action_stats &s = stats[act.name];
+      s.calls++;
+      mock::counters before = mock::current().ops;
+      try
+      {
+        mock::call(CODE_ACCOUNT, code, act.name, act.data);
+      }
+      catch (const mock::assertion &)
+      {
+        s.failures++;
+        add_ops(s.ops, mock::current().ops, before);
+        throw;
+      }
+      add_ops(s.ops, mock::current().ops, before);
+    }
+  };
+}
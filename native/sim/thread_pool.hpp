@@ -0,0 +1,77 @@
+/**
+ *  @file thread_pool.hpp
+ *
+ *  Fixed number of workers running submitted jobs in submission order.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace sim
+{
+  class thread_pool
+  {
+  public:
+    explicit thread_pool(size_t threads)
+    {
+      for (size_t i = 0; i < threads; i++)
+      {
+        workers.emplace_back([this] { run(); });
+      }
+    }
+
+    //waits for submitted jobs to finish
+    ~thread_pool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      ready.notify_all();
+      for (auto &w : workers)
+      {
+        w.join();
+      }
+    }
+
+    void submit(std::function<void()> job)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push(std::move(job));
+      }
+      ready.notify_one();
+    }
+
+  private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping = false;
+
+    void run()
+    {
+      while (true)
+      {
+        std::function<void()> job;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+          if (jobs.empty())
+          {
+            return;
+          }
+          job = std::move(jobs.front());
+          jobs.pop();
+        }
+        job();
+      }
+    }
+  };
+}
@@ -0,0 +1,355 @@
+/**
+ *  @file snapshot.hpp
+ *
+ *  Contract tables section of a nodeos portable snapshot (nodeos --snapshot, EOSIO 1.6 and later).
+ *  Snapshot starts with magic and version, followed by sections of
+ *  (size, row count, null terminated name, rows) and an end marker.
+ *  Section contract_tables holds, for every table, its table_id row, then for primary and each
+ *  secondary index type a varint row count and the rows. Rows are in chain wire format,
+ *  lengths of strings and vectors are varints, unlike mock serialization.
+ */
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace snapshot
+{
+  static const uint32_t MAGIC = 0x30510550;
+  static const uint32_t VERSION = 1;
+  static const uint64_t END_MARKER = ~uint64_t(0);
+  static const char *CONTRACT_TABLES = "contract_tables";
+
+  //sizes of secondary index rows, (primary_key, payer, secondary_key) of
+  //index64, index128, index256, index_double and index_long_double
+  static const uint32_t SECONDARY_ROW_SIZES[] = {24, 32, 48, 24, 32};
+
+  struct chain_writer
+  {
+    std::vector<char> bytes;
+
+    void write(const void *data, size_t size)
+    {
+      const char *c = static_cast<const char *>(data);
+      bytes.insert(bytes.end(), c, c + size);
+    }
+  };
+
+  struct chain_reader
+  {
+    const char *pos;
+    const char *end;
+
+    void read(void *data, size_t size)
+    {
+      eosio_assert(size <= size_t(end - pos), "row is truncated");
+      std::memcpy(data, pos, size);
+      pos += size;
+    }
+  };
+
+  inline void write_varint(chain_writer &ds, uint64_t v)
+  {
+    do
+    {
+      uint8_t b = uint8_t(v & 0x7f);
+      v >>= 7;
+      b |= uint8_t((v > 0) << 7);
+      ds.write(&b, 1);
+    } while (v > 0);
+  }
+
+  inline uint64_t read_varint(chain_reader &ds)
+  {
+    uint64_t v = 0;
+    uint8_t b = 0;
+    uint32_t shift = 0;
+    do
+    {
+      ds.read(&b, 1);
+      v |= uint64_t(b & 0x7f) << shift;
+      shift += 7;
+    } while ((b & 0x80) && shift < 64);
+    return v;
+  }
+
+  template <typename T>
+  std::enable_if_t<std::is_arithmetic<T>::value, chain_writer &> operator<<(chain_writer &ds, const T &v)
+  {
+    ds.write(&v, sizeof(v));
+    return ds;
+  }
+
+  template <typename T>
+  std::enable_if_t<std::is_arithmetic<T>::value, chain_reader &> operator>>(chain_reader &ds, T &v)
+  {
+    ds.read(&v, sizeof(v));
+    return ds;
+  }
+
+  inline chain_writer &operator<<(chain_writer &ds, const std::string &v)
+  {
+    write_varint(ds, v.size());
+    ds.write(v.data(), v.size());
+    return ds;
+  }
+
+  inline chain_reader &operator>>(chain_reader &ds, std::string &v)
+  {
+    uint64_t size = read_varint(ds);
+    eosio_assert(size <= uint64_t(ds.end - ds.pos), "row is truncated");
+    v.assign(ds.pos, size);
+    ds.pos += size;
+    return ds;
+  }
+
+  template <typename T>
+  chain_writer &operator<<(chain_writer &ds, const std::vector<T> &v)
+  {
+    write_varint(ds, v.size());
+    for (const auto &i : v)
+    {
+      ds << i;
+    }
+    return ds;
+  }
+
+  template <typename T>
+  chain_reader &operator>>(chain_reader &ds, std::vector<T> &v)
+  {
+    uint64_t size = read_varint(ds);
+    eosio_assert(size <= uint64_t(ds.end - ds.pos), "row is truncated");
+    v.resize(size);
+    for (auto &i : v)
+    {
+      ds >> i;
+    }
+    return ds;
+  }
+
+  template <typename T>
+  std::vector<char> pack(const T &value)
+  {
+    chain_writer ds;
+    ds << value;
+    return std::move(ds.bytes);
+  }
+
+  template <typename T>
+  T unpack(const char *data, size_t size)
+  {
+    T value;
+    chain_reader ds{data, data + size};
+    ds >> value;
+    return value;
+  }
+
+  //snapshot with contract_tables section only, other sections are not needed to read contract state
+  class writer
+  {
+  public:
+    explicit writer(const std::string &path) : out(path, std::ios::binary)
+    {
+      eosio_assert(out.good(), ("cannot write " + path).c_str());
+      write(MAGIC);
+      write(VERSION);
+      section_pos = out.tellp();
+      write(END_MARKER); // size, set by close
+      write(END_MARKER); // row count, set by close
+      out.write(CONTRACT_TABLES, std::strlen(CONTRACT_TABLES) + 1);
+    }
+
+    ~writer()
+    {
+      close();
+    }
+
+    //table_id row and primary rows of a table, secondary indices are written empty
+    void add_table(uint64_t code, uint64_t scope, uint64_t table, uint64_t payer,
+                   const std::vector<std::pair<uint64_t, std::vector<char>>> &rows)
+    {
+      write(code);
+      write(scope);
+      write(table);
+      write(payer);
+      write(uint32_t(rows.size()));
+      write_count(rows.size());
+      for (const auto &r : rows)
+      {
+        chain_writer ds;
+        ds << r.first << payer << std::string(r.second.begin(), r.second.end());
+        out.write(ds.bytes.data(), ds.bytes.size());
+      }
+      for (size_t i = 0; i < sizeof(SECONDARY_ROW_SIZES) / sizeof(SECONDARY_ROW_SIZES[0]); i++)
+      {
+        write_count(0);
+      }
+      row_count += 7 + rows.size();
+    }
+
+    //all rows of a multi_index in its scope
+    template <typename Table>
+    void add_table(Table &t, uint64_t table, uint64_t payer)
+    {
+      std::vector<std::pair<uint64_t, std::vector<char>>> rows;
+      for (auto itr = t.begin(); itr != t.end(); itr++)
+      {
+        rows.emplace_back(itr->primary_key(), pack(*itr));
+      }
+      if (rows.size() > 0)
+      {
+        add_table(t.get_code(), t.get_scope(), table, payer, rows);
+      }
+    }
+
+    void close()
+    {
+      if (!out.is_open())
+      {
+        return;
+      }
+      auto end = out.tellp();
+      uint64_t size = uint64_t(end - section_pos) - sizeof(uint64_t);
+      out.seekp(section_pos);
+      write(size);
+      write(row_count);
+      out.seekp(end);
+      write(END_MARKER);
+      out.close();
+    }
+
+  private:
+    std::ofstream out;
+    std::streampos section_pos;
+    uint64_t row_count = 0;
+
+    template <typename T>
+    void write(const T &v)
+    {
+      out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+
+    void write_count(uint64_t count)
+    {
+      chain_writer ds;
+      write_varint(ds, count);
+      out.write(ds.bytes.data(), ds.bytes.size());
+    }
+  };
+
+  //primary row of a contract table, value points into reader::arena
+  struct row
+  {
+    uint64_t scope;
+    uint64_t table;
+    uint64_t primary_key;
+    size_t offset;
+    uint32_t size;
+  };
+
+  //streams through a snapshot keeping primary rows of given tables, each of the code owning it,
+  //sections other than contract_tables and rows of other contracts are skipped
+  class reader
+  {
+  public:
+    std::vector<row> rows;
+    std::vector<char> arena; // values of rows, back to back
+    uint64_t tables_seen = 0;
+
+    reader(const std::string &path, const std::map<uint64_t, uint64_t> &tables) : in(path, std::ios::binary)
+    {
+      eosio_assert(in.good(), ("cannot read " + path).c_str());
+      eosio_assert(read<uint32_t>() == MAGIC, "not a portable snapshot");
+      read<uint32_t>(); // version, layout of contract_tables is the same across versions
+      while (true)
+      {
+        uint64_t size = read<uint64_t>();
+        if (size == END_MARKER)
+        {
+          break;
+        }
+        auto start = in.tellg();
+        read<uint64_t>(); // row count
+        std::string name;
+        std::getline(in, name, '\0');
+        if (name == CONTRACT_TABLES)
+        {
+          read_contract_tables(uint64_t(start) + size, tables);
+        }
+        in.seekg(uint64_t(start) + size);
+        eosio_assert(in.good(), "snapshot is truncated");
+      }
+    }
+
+    const char *data(const row &r) const
+    {
+      return arena.data() + r.offset;
+    }
+
+  private:
+    std::ifstream in;
+
+    template <typename T>
+    T read()
+    {
+      T v;
+      in.read(reinterpret_cast<char *>(&v), sizeof(v));
+      eosio_assert(in.good(), "snapshot is truncated");
+      return v;
+    }
+
+    uint64_t read_varint()
+    {
+      uint64_t v = 0;
+      uint32_t shift = 0;
+      uint8_t b = 0;
+      do
+      {
+        b = read<uint8_t>();
+        v |= uint64_t(b & 0x7f) << shift;
+        shift += 7;
+      } while ((b & 0x80) && shift < 64);
+      return v;
+    }
+
+    void read_contract_tables(uint64_t end, const std::map<uint64_t, uint64_t> &tables)
+    {
+      while (uint64_t(in.tellg()) < end)
+      {
+        uint64_t t_code = read<uint64_t>();
+        uint64_t t_scope = read<uint64_t>();
+        uint64_t t_table = read<uint64_t>();
+        read<uint64_t>(); // payer
+        read<uint32_t>(); // count
+        auto owner = tables.find(t_table);
+        bool keep = owner != tables.end() && owner->second == t_code;
+        tables_seen++;
+
+        uint64_t count = read_varint();
+        for (uint64_t i = 0; i < count; i++)
+        {
+          uint64_t pk = read<uint64_t>();
+          read<uint64_t>(); // payer
+          uint64_t size = read_varint();
+          if (!keep)
+          {
+            in.ignore(size);
+            continue;
+          }
+          rows.push_back(row{t_scope, t_table, pk, arena.size(), uint32_t(size)});
+          arena.resize(arena.size() + size);
+          in.read(arena.data() + rows.back().offset, size);
+          eosio_assert(in.good(), "snapshot is truncated");
+        }
+        for (uint32_t row_size : SECONDARY_ROW_SIZES)
+        {
+          in.ignore(read_varint() * row_size);
+        }
+      }
+    }
+  };
+}
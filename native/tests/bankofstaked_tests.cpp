@@ -0,0 +1,879 @@
+/**
+ *  @file bankofstaked_tests.cpp
+ *
+ *  Behavior of contract logic on the mock chain. Purchases and maintenance run
+ *  through sim::node, so inline actions, deferred expiry and refunds are applied
+ *  and failed transactions are rolled back, then resulting table state is checked.
+ */
+#define BOOST_TEST_MODULE bankofstaked_native_tests
+#include <boost/test/included/unit_test.hpp>
+#include <contracts.hpp>
+#include <fixture.hpp>
+#include <sim/node.hpp>
+
+using namespace fixture;
+
+namespace
+{
+  //fresh chain with plans of setup_plans and default config
+  struct bank_fixture
+  {
+    sim::node node;
+
+    bank_fixture()
+    {
+      mock::reset();
+      mock::set_now(GENESIS);
+      setup_plans();
+      clear();
+    }
+
+    void set_shards(uint64_t free_shards, uint64_t paid_shards)
+    {
+      admin(N(setconfig), pack(std::make_tuple(free_shards, paid_shards, DEFAULT_ROTATE_DEPTH, DEFAULT_HIGH_WATERMARK,
+                                               DEFAULT_LAG_THRESHOLD, DEFAULT_MAX_EXPIRY_BATCH)));
+    }
+
+    //paid creditor of balance, in 0.0001 EOS, RAM is not limited if ram_bytes is 0
+    void add_paid(account_name account, int64_t balance, bool active = true, int64_t ram_bytes = 0)
+    {
+      addcreditor(account, false, asset(balance, EOS_SYMBOL), ram_bytes);
+      if (active)
+      {
+        activate(account);
+      }
+      clear();
+    }
+
+    //free creditor of balance, in 0.0001 EOS
+    void add_free(account_name account, int64_t balance)
+    {
+      addcreditor(account, true, asset(balance, EOS_SYMBOL));
+      activate(account);
+      clear();
+    }
+
+    bool buy(account_name buyer, int64_t amount, account_name beneficiary)
+    {
+      return node.push_transfer(buyer, CODE_ACCOUNT, asset(amount, EOS_SYMBOL), name{beneficiary}.to_string());
+    }
+
+    bool push(action_name act, const std::vector<char> &data)
+    {
+      //data is packed already, action constructor would pack it again
+      action a;
+      a.account = CODE_ACCOUNT;
+      a.name = act;
+      a.authorization = {permission_level{CODE_ACCOUNT, N(active)}};
+      a.data = data;
+      return node.push_transaction({a});
+    }
+
+    //live orders of beneficiary of given kind, looked up through orderidx
+    std::vector<order> orders_of(account_name beneficiary, uint64_t is_free = FALSE)
+    {
+      std::vector<order> orders;
+      orderidx_table x(CODE_ACCOUNT, SCOPE);
+      auto idx = x.get_index<N(beneficiary)>();
+      uint128_t key = get_account_key(beneficiary, is_free);
+      for (auto itr = idx.lower_bound(key); itr != idx.end() && itr->get_beneficiary_key() == key; itr++)
+      {
+        order_table o(CODE_ACCOUNT, get_order_scope(itr->order_id));
+        orders.emplace_back(o.get(itr->order_id));
+      }
+      return orders;
+    }
+
+    creditor get_creditor(account_name account)
+    {
+      creditor_table c(CODE_ACCOUNT, SCOPE);
+      return c.get(account);
+    }
+
+    bool failed_with(const std::string &message) const
+    {
+      return node.failures.count(message) > 0;
+    }
+  };
+}
+
+BOOST_FIXTURE_TEST_SUITE(merge_tests, bank_fixture)
+
+BOOST_AUTO_TEST_CASE(renewal_extends_segment)
+{
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  mock::set_now(GENESIS + 3600);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+
+  auto orders = orders_of(N(benefa));
+  BOOST_REQUIRE_EQUAL(orders.size(), 1u);
+  BOOST_REQUIRE_EQUAL(orders[0].segments.size(), 1u);
+  BOOST_CHECK_EQUAL(orders[0].expire_at, GENESIS + 14 * SECONDS_PER_DAY);
+  BOOST_CHECK_EQUAL(orders[0].price.amount, 2 * PAID_PRICE);
+  // renewal keeps the delegation, nothing more is staked
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).cpu_staked.amount, 100000);
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).delegations, 1u);
+  BOOST_CHECK_EQUAL(get_metrics().renewals, 1u);
+  BOOST_CHECK_EQUAL(get_metrics().purchases, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(topup_adds_segment)
+{
+  setplan(asset(20000, EOS_SYMBOL), asset(50000, EOS_SYMBOL), asset(5000, EOS_SYMBOL), 24 * 60, false);
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_REQUIRE(buy(N(buyera), 20000, N(benefa)));
+
+  auto orders = orders_of(N(benefa));
+  BOOST_REQUIRE_EQUAL(orders.size(), 1u);
+  BOOST_REQUIRE_EQUAL(orders[0].segments.size(), 2u);
+  BOOST_CHECK_EQUAL(orders[0].expire_at, GENESIS + SECONDS_PER_DAY);
+  BOOST_CHECK_EQUAL(orders[0].cpu_staked.amount, 150000);
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).cpu_staked.amount, 150000);
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).delegations, 1u);
+  BOOST_CHECK_EQUAL(get_metrics().topups, 1u);
+
+  // day segment expires on its own, week segment stays delegated
+  node.advance(GENESIS + SECONDS_PER_DAY + 60);
+  orders = orders_of(N(benefa));
+  BOOST_REQUIRE_EQUAL(orders.size(), 1u);
+  BOOST_REQUIRE_EQUAL(orders[0].segments.size(), 1u);
+  BOOST_CHECK_EQUAL(orders[0].expire_at, GENESIS + 7 * SECONDS_PER_DAY);
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).cpu_staked.amount, 100000);
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).delegations, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(other_buyer_gets_own_order)
+{
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_REQUIRE(buy(N(buyerb), PAID_PRICE, N(benefa)));
+
+  auto orders = orders_of(N(benefa));
+  BOOST_REQUIRE_EQUAL(orders.size(), 2u);
+  BOOST_CHECK(orders[0].buyer != orders[1].buyer);
+  BOOST_CHECK_EQUAL(orders[0].price.amount, PAID_PRICE);
+  BOOST_CHECK_EQUAL(orders[1].price.amount, PAID_PRICE);
+  BOOST_CHECK_EQUAL(get_metrics().renewals, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(merge_at_order_limit)
+{
+  add_paid(N(credita), 100000000);
+  for (uint64_t i = 0; i < MAX_PAID_ORDERS; i++)
+  {
+    BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, account("benef", i)));
+  }
+  // renewal adds no order, buyer at its limit could still renew
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, account("benef", 0)));
+  BOOST_CHECK_EQUAL(orders_of(account("benef", 0)).size(), 1u);
+  BOOST_CHECK_EQUAL(get_metrics().renewals, 1u);
+
+  BOOST_CHECK(!buy(N(buyera), PAID_PRICE, N(benefz)));
+  BOOST_CHECK(failed_with(std::to_string(MAX_PAID_ORDERS) + " affective orders at most for each buyer"));
+  BOOST_CHECK_EQUAL(orders_of(N(benefz)).size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(merge_refused_on_inactive_creditor)
+{
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  // one paid shard, creditb replaces credita
+  add_paid(N(creditb), 20000000);
+  BOOST_REQUIRE_EQUAL(get_creditor(N(credita)).is_active, FALSE);
+
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  auto orders = orders_of(N(benefa));
+  BOOST_REQUIRE_EQUAL(orders.size(), 2u);
+  BOOST_CHECK(orders[0].creditor != orders[1].creditor);
+  BOOST_CHECK_EQUAL(get_metrics().renewals, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(merge_refused_on_split_order)
+{
+  set_shards(1, 3);
+  add_paid(N(credita), 100000);
+  add_paid(N(creditb), 100000);
+  add_paid(N(creditc), 100000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_REQUIRE_EQUAL(orders_of(N(benefa)).size(), 1u);
+  BOOST_REQUIRE(is_split_order(orders_of(N(benefa))[0]));
+
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_CHECK_EQUAL(orders_of(N(benefa)).size(), 2u);
+  BOOST_CHECK_EQUAL(get_metrics().renewals + get_metrics().topups, 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(split_tests, bank_fixture)
+
+BOOST_AUTO_TEST_CASE(dust_creditor_gets_no_leg)
+{
+  set_shards(1, 2);
+  add_paid(N(credita), 109990);
+  add_paid(N(creditb), 10);
+  // creditb could only stake 10, its leg would be priced 1 and earn 0
+  BOOST_CHECK(!buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_CHECK(failed_with("creditors have no enough balance to delegate"));
+  BOOST_CHECK_EQUAL(orders_of(N(benefa)).size(), 0u);
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).available.amount, 109990);
+  BOOST_CHECK_EQUAL(get_creditor(N(creditb)).available.amount, 10);
+}
+
+BOOST_AUTO_TEST_CASE(inactive_creditor_gets_no_leg)
+{
+  set_shards(1, 2);
+  add_paid(N(credita), 60000);
+  add_paid(N(creditb), 60000, false);
+  BOOST_CHECK(!buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_CHECK_EQUAL(get_creditor(N(creditb)).available.amount, 60000);
+
+  activate(N(creditb));
+  clear();
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  auto orders = orders_of(N(benefa));
+  BOOST_REQUIRE_EQUAL(orders.size(), 1u);
+  BOOST_CHECK_EQUAL(orders[0].segments.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(legs_leave_min_stake_to_next_leg)
+{
+  set_shards(1, 2);
+  add_paid(N(credita), 105000);
+  add_paid(N(creditb), 105000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  auto orders = orders_of(N(benefa));
+  BOOST_REQUIRE_EQUAL(orders.size(), 1u);
+  BOOST_REQUIRE_EQUAL(orders[0].segments.size(), 2u);
+  int64_t price = 0;
+  for (const auto &s : orders[0].segments)
+  {
+    BOOST_CHECK_GE((s.cpu + s.net).amount, MIN_LEG_STAKE);
+    BOOST_CHECK_GE(get_income(s.creditor, s.price).amount, 1);
+    price += s.price.amount;
+  }
+  BOOST_CHECK_EQUAL(price, PAID_PRICE);
+  BOOST_CHECK_EQUAL((orders[0].cpu_staked + orders[0].net_staked).amount, 110000);
+}
+
+BOOST_AUTO_TEST_CASE(split_order_expires_every_leg)
+{
+  set_shards(1, 2);
+  add_paid(N(credita), 60000);
+  add_paid(N(creditb), 60000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_REQUIRE_EQUAL(orders_of(N(benefa))[0].segments.size(), 2u);
+  BOOST_CHECK_EQUAL(get_metrics().splits, 1u);
+
+  node.advance(GENESIS + 7 * SECONDS_PER_DAY + 60);
+  BOOST_CHECK(node.failures.empty());
+  BOOST_CHECK_EQUAL(orders_of(N(benefa)).size(), 0u);
+  int64_t unstaked = 0;
+  for (account_name account : {N(credita), N(creditb)})
+  {
+    creditor entry = get_creditor(account);
+    BOOST_CHECK_EQUAL(entry.cpu_staked.amount, 0);
+    BOOST_CHECK_EQUAL(entry.net_staked.amount, 0);
+    BOOST_CHECK_EQUAL(entry.delegations, 0u);
+    unstaked += (entry.cpu_unstaked + entry.net_unstaked).amount;
+  }
+  BOOST_CHECK_EQUAL(unstaked, 110000);
+  BOOST_CHECK_EQUAL(get_metrics().paid_orders, 0u);
+  BOOST_CHECK_EQUAL(get_metrics().paid_expired, 2u);
+  history_table h(CODE_ACCOUNT, SCOPE);
+  BOOST_CHECK_EQUAL(std::distance(h.begin(), h.end()), 2);
+}
+
+BOOST_AUTO_TEST_CASE(zero_reserved_is_not_transferred)
+{
+  add_paid(N(credita), 10000000);
+  dividend_table d(CODE_ACCOUNT, CODE_ACCOUNT);
+  d.emplace(RAM_PAYER, [&](auto &i) {
+    i.account = N(credita);
+    i.percentage = 100;
+  });
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+
+  node.advance(GENESIS + 7 * SECONDS_PER_DAY + 60);
+  BOOST_CHECK(node.failures.empty());
+  BOOST_CHECK_EQUAL(orders_of(N(benefa)).size(), 0u);
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).cpu_staked.amount, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(metrics_tests, bank_fixture)
+
+BOOST_AUTO_TEST_CASE(idle_check_writes_nothing)
+{
+  // free shard stays short of creditors, each check scans the same ones
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  mock::set_now(GENESIS + 60);
+  node.stats.clear();
+  BOOST_REQUIRE(buy(N(buyerb), PAID_PRICE, N(benefb)));
+  const auto &ops = node.stats[N(check)].ops;
+  BOOST_CHECK_EQUAL(node.stats[N(check)].calls, 1u);
+  BOOST_CHECK_EQUAL(ops.modifies + ops.emplaces + ops.erases, 0u);
+  BOOST_CHECK_EQUAL(get_metrics().checked_at, 0u);
+  BOOST_CHECK_EQUAL(get_metrics().purchases, 2u);
+
+  // deferred expiry not delivered yet, check of next purchase expires the order
+  mock::set_now(GENESIS + 7 * SECONDS_PER_DAY + 60);
+  BOOST_REQUIRE(buy(N(buyerc), PAID_PRICE, N(benefc)));
+  BOOST_CHECK_EQUAL(get_metrics().checked_at, now());
+  node.advance(now());
+  BOOST_CHECK_EQUAL(orders_of(N(benefa)).size(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(refund_tests, bank_fixture)
+
+// paid order of credita expired at GENESIS + 7 days, its 110000 refunded by eosio 3 days later
+static const uint32_t REFUNDED_AT = GENESIS + 10 * SECONDS_PER_DAY + 60;
+
+BOOST_AUTO_TEST_CASE(refund_settles_into_available)
+{
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  node.advance(GENESIS + 7 * SECONDS_PER_DAY + 60);
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).cpu_unstaked.amount, 100000);
+
+  node.advance(REFUNDED_AT);
+  BOOST_REQUIRE(buy(N(buyerb), PAID_PRICE, N(benefb)));
+  creditor c = get_creditor(N(credita));
+  BOOST_CHECK_EQUAL(c.available.amount, get_balance(N(credita)).amount);
+  BOOST_CHECK_EQUAL(c.cpu_unstaked.amount, 0);
+  BOOST_CHECK_EQUAL(c.net_unstaked.amount, 0);
+}
+
+BOOST_AUTO_TEST_CASE(reconcile_before_maturity_settles_refund)
+{
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  node.advance(REFUNDED_AT);
+
+  // balance read by reconcile already holds the refund
+  BOOST_REQUIRE(push(N(reconcile), pack(std::make_tuple(N(credita)))));
+  creditor c = get_creditor(N(credita));
+  BOOST_CHECK_EQUAL(c.available.amount, get_balance(N(credita)).amount);
+  BOOST_CHECK_EQUAL(c.cpu_unstaked.amount, 0);
+  BOOST_CHECK_EQUAL(c.net_unstaked.amount, 0);
+  refunding_table r(CODE_ACCOUNT, SCOPE);
+  BOOST_CHECK(r.find(N(credita)) == r.end());
+
+  BOOST_REQUIRE(buy(N(buyerb), PAID_PRICE, N(benefb)));
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).available.amount, get_balance(N(credita)).amount);
+}
+
+BOOST_AUTO_TEST_CASE(activation_before_maturity_settles_refund)
+{
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  node.advance(REFUNDED_AT);
+
+  // rotation resets available the same way
+  BOOST_REQUIRE(push(N(activate), pack(std::make_tuple(N(credita)))));
+  BOOST_REQUIRE(buy(N(buyerb), PAID_PRICE, N(benefb)));
+  creditor c = get_creditor(N(credita));
+  BOOST_CHECK_EQUAL(c.available.amount, get_balance(N(credita)).amount);
+  BOOST_CHECK_EQUAL(c.cpu_unstaked.amount, 0);
+  BOOST_CHECK_EQUAL(c.net_unstaked.amount, 0);
+}
+
+BOOST_AUTO_TEST_CASE(reconcile_keeps_pending_refund)
+{
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  node.advance(GENESIS + 8 * SECONDS_PER_DAY);
+
+  // not refunded yet, balance does not hold it
+  BOOST_REQUIRE(push(N(reconcile), pack(std::make_tuple(N(credita)))));
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).cpu_unstaked.amount, 100000);
+  node.advance(REFUNDED_AT);
+  BOOST_REQUIRE(buy(N(buyerb), PAID_PRICE, N(benefb)));
+  creditor c = get_creditor(N(credita));
+  BOOST_CHECK_EQUAL(c.available.amount, get_balance(N(credita)).amount);
+  BOOST_CHECK_EQUAL(c.cpu_unstaked.amount, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(admin_migration_tests, bank_fixture)
+
+//rows bankofstaked wrote to its own tables before bankadmin owned them
+static void add_old_rows(uint64_t count)
+{
+  config_table cfg(CODE_ACCOUNT, SCOPE);
+  config c = get_config();
+  c.free_shards = 3;
+  cfg.set(c, RAM_PAYER);
+
+  plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
+  p.emplace(RAM_PAYER, [&](auto &i) {
+    i = get_plans()[1];
+    i.id = 0;
+    i.cpu = asset(1, EOS_SYMBOL);
+  });
+  p.emplace(RAM_PAYER, [&](auto &i) {
+    i = get_plans()[1];
+    i.id = 1;
+    i.price = asset(5000, EOS_SYMBOL);
+  });
+
+  safecreditor_table s(CODE_ACCOUNT, SCOPE);
+  blacklist_table b(CODE_ACCOUNT, SCOPE);
+  whitelist_table w(CODE_ACCOUNT, SCOPE);
+  s.emplace(RAM_PAYER, [&](auto &i) { i.account = N(credita); });
+  for (uint64_t i = 0; i < count; i++)
+  {
+    b.emplace(RAM_PAYER, [&](auto &e) { e.account = account("black", i); });
+    w.emplace(RAM_PAYER, [&](auto &e) {
+      e.account = account("white", i);
+      e.capacity = i + 1;
+    });
+  }
+}
+
+template <typename Table>
+static uint64_t count_rows(account_name code)
+{
+  Table t(code, SCOPE);
+  return std::distance(t.begin(), t.end());
+}
+
+BOOST_AUTO_TEST_CASE(migrate_copies_rows_in_batches)
+{
+  add_old_rows(5);
+  // admin rows set since the split are kept
+  admin(N(addwhitelist), pack(std::make_tuple(account("white", 0), uint64_t(9))));
+
+  uint64_t calls = 0;
+  rowmigration_table m(ADMIN_ACCOUNT, SCOPE);
+  while (!m.exists() || m.get().step < ROWS_MIGRATED)
+  {
+    admin(N(migrate), pack(std::make_tuple(uint64_t(2))));
+    calls++;
+    BOOST_REQUIRE(calls < 10);
+  }
+  // 1 safecreditor, 5 blacklist and 5 whitelist rows, 2 of them for each call
+  BOOST_CHECK_EQUAL(calls, 6u);
+  BOOST_CHECK_THROW(admin(N(migrate), pack(std::make_tuple(uint64_t(2)))), mock::assertion);
+
+  BOOST_CHECK_EQUAL(get_config().free_shards, 3u);
+  auto plans = get_plans();
+  BOOST_REQUIRE_EQUAL(plans.size(), 3u);
+  BOOST_CHECK_EQUAL(plans[1].price.amount, 5000);
+  BOOST_CHECK(plans[1].id != plans[0].id && plans[1].id != plans[2].id);
+  BOOST_CHECK_EQUAL(plans[2].price.amount, PAID_PRICE);
+  BOOST_CHECK_EQUAL(plans[2].cpu.amount, 100000);
+
+  BOOST_CHECK_EQUAL(count_rows<safecreditor_table>(ADMIN_ACCOUNT), 1u);
+  BOOST_CHECK_EQUAL(count_rows<blacklist_table>(ADMIN_ACCOUNT), 5u);
+  BOOST_CHECK_EQUAL(count_rows<whitelist_table>(ADMIN_ACCOUNT), 5u);
+  whitelist_table w(ADMIN_ACCOUNT, SCOPE);
+  BOOST_CHECK_EQUAL(w.get(account("white", 0)).capacity, 9u);
+  BOOST_CHECK_EQUAL(w.get(account("white", 4)).capacity, 5u);
+}
+
+BOOST_AUTO_TEST_CASE(migrated_blacklist_refuses_purchase)
+{
+  add_old_rows(1);
+  add_paid(N(credita), 10000000);
+  admin(N(migrate), pack(std::make_tuple(uint64_t(10))));
+  BOOST_CHECK(!buy(account("black", 0), PAID_PRICE, N(benefa)));
+  BOOST_CHECK(!buy(N(buyera), PAID_PRICE, account("black", 0)));
+  BOOST_CHECK_EQUAL(node.failures["something wrong with your account"], 2u);
+  BOOST_CHECK(buy(N(buyera), PAID_PRICE, N(benefa)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(freelock_tests, bank_fixture)
+
+BOOST_AUTO_TEST_CASE(lock_refuses_free_order_within_a_day)
+{
+  add_free(N(freea), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), FREE_PRICE, N(benefa)));
+  freelock_table f(CODE_ACCOUNT, SCOPE);
+  BOOST_CHECK_EQUAL(f.get(N(benefa)).expire_at, GENESIS + SECONDS_PER_DAY);
+
+  mock::set_now(GENESIS + SECONDS_PER_DAY - 60);
+  BOOST_CHECK(!buy(N(buyerb), FREE_PRICE, N(benefa)));
+  BOOST_CHECK(failed_with("free plan is avaliable every 24 hours for each beneficiary"));
+}
+
+BOOST_AUTO_TEST_CASE(expired_lock_is_reused_in_place)
+{
+  add_free(N(freea), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), FREE_PRICE, N(benefa)));
+  node.advance(GENESIS + SECONDS_PER_DAY + 60);
+
+  // not swept yet, the purchase overwrites it
+  freelock_table f(CODE_ACCOUNT, SCOPE);
+  BOOST_REQUIRE(f.find(N(benefa)) != f.end());
+  BOOST_REQUIRE(buy(N(buyera), FREE_PRICE, N(benefa)));
+  BOOST_CHECK_EQUAL(f.get(N(benefa)).created_at, now());
+  BOOST_CHECK_EQUAL(f.get(N(benefa)).expire_at, now() + SECONDS_PER_DAY);
+  BOOST_CHECK_EQUAL(std::distance(f.begin(), f.end()), 1);
+}
+
+BOOST_AUTO_TEST_CASE(sweep_drops_past_days_only)
+{
+  add_free(N(freea), 10000000);
+  for (uint64_t i = 0; i < 4; i++)
+  {
+    BOOST_REQUIRE(buy(N(buyera), FREE_PRICE, account("benef", i)));
+  }
+  // lock of benefx expires in the day of the sweep, expired but kept for reuse
+  node.advance(GENESIS + SECONDS_PER_DAY + 60);
+  BOOST_REQUIRE(buy(N(buyera), FREE_PRICE, N(benefx)));
+  node.advance(GENESIS + 2 * SECONDS_PER_DAY + 3600);
+  BOOST_REQUIRE_EQUAL(now() / SECONDS_PER_DAY, (GENESIS + 2 * SECONDS_PER_DAY + 60) / SECONDS_PER_DAY);
+
+  BOOST_REQUIRE(push(N(sweeplocks), pack(std::make_tuple(uint64_t(3)))));
+  freelock_table f(CODE_ACCOUNT, SCOPE);
+  BOOST_CHECK_EQUAL(std::distance(f.begin(), f.end()), 2);
+  BOOST_REQUIRE(push(N(sweeplocks), pack(std::make_tuple(uint64_t(3)))));
+  BOOST_CHECK_EQUAL(std::distance(f.begin(), f.end()), 1);
+  BOOST_CHECK(f.find(N(benefx)) != f.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(partition_tests, bank_fixture)
+
+BOOST_AUTO_TEST_CASE(orders_go_to_partition_of_expiry_day)
+{
+  add_free(N(freea), 10000000);
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), FREE_PRICE, N(benefa)));
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_REQUIRE(buy(N(buyerb), PAID_PRICE, N(benefb)));
+
+  uint64_t free_day = get_partition(GENESIS + SECONDS_PER_DAY);
+  uint64_t paid_day = get_partition(GENESIS + 7 * SECONDS_PER_DAY);
+  BOOST_CHECK(get_orderdir().partitions == std::vector<uint64_t>({free_day, paid_day}));
+
+  order_table free_orders(CODE_ACCOUNT, get_partition_scope(free_day));
+  order_table paid_orders(CODE_ACCOUNT, get_partition_scope(paid_day));
+  BOOST_CHECK_EQUAL(std::distance(free_orders.begin(), free_orders.end()), 1);
+  BOOST_CHECK_EQUAL(std::distance(paid_orders.begin(), paid_orders.end()), 2);
+  BOOST_CHECK_EQUAL(free_orders.begin()->beneficiary, N(benefa));
+  BOOST_CHECK_EQUAL(get_order_scope(orders_of(N(benefb))[0].id), get_partition_scope(paid_day));
+}
+
+BOOST_AUTO_TEST_CASE(check_prunes_empty_past_partitions)
+{
+  add_free(N(freea), 10000000);
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), FREE_PRICE, N(benefa)));
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  uint64_t free_day = get_partition(GENESIS + SECONDS_PER_DAY);
+  uint64_t paid_day = get_partition(GENESIS + 7 * SECONDS_PER_DAY);
+
+  // free order expired by its deferred expiry, its partition stays listed until a check
+  node.advance(GENESIS + SECONDS_PER_DAY + 60);
+  BOOST_CHECK_EQUAL(orders_of(N(benefa), TRUE).size(), 0u);
+  BOOST_CHECK_EQUAL(get_orderdir().partitions.size(), 2u);
+
+  // a check in the day of the empty partition keeps it
+  BOOST_REQUIRE(buy(N(buyerb), PAID_PRICE, N(benefb)));
+  BOOST_CHECK_EQUAL(get_orderdir().partitions.front(), free_day);
+
+  node.advance(GENESIS + 2 * SECONDS_PER_DAY + 60);
+  BOOST_REQUIRE(buy(N(buyerc), PAID_PRICE, N(benefc)));
+  auto partitions = get_orderdir().partitions;
+  BOOST_CHECK(std::find(partitions.begin(), partitions.end(), free_day) == partitions.end());
+  BOOST_CHECK(std::find(partitions.begin(), partitions.end(), paid_day) != partitions.end());
+  BOOST_CHECK(std::is_sorted(partitions.begin(), partitions.end()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(order_key_tests, bank_fixture)
+
+BOOST_AUTO_TEST_CASE(beneficiary_limit_counts_orders_of_its_kind)
+{
+  add_free(N(freea), 10000000);
+  add_paid(N(credita), 100000000);
+  BOOST_REQUIRE(buy(N(buyerx), FREE_PRICE, N(benefa)));
+  for (uint64_t i = 0; i < MAX_PAID_ORDERS; i++)
+  {
+    BOOST_REQUIRE(buy(account("buyer", i), PAID_PRICE, N(benefa)));
+  }
+  BOOST_CHECK_EQUAL(orders_of(N(benefa)).size(), MAX_PAID_ORDERS);
+  BOOST_CHECK_EQUAL(orders_of(N(benefa), TRUE).size(), 1u);
+
+  BOOST_CHECK(!buy(account("buyer", MAX_PAID_ORDERS), PAID_PRICE, N(benefa)));
+  BOOST_CHECK(failed_with("20 affective orders at most for each beneficiary"));
+}
+
+BOOST_AUTO_TEST_CASE(buyer_limit_counts_orders_of_its_kind)
+{
+  add_free(N(freea), 10000000);
+  add_paid(N(credita), 10000000);
+  for (uint64_t i = 0; i < MAX_FREE_ORDERS; i++)
+  {
+    BOOST_REQUIRE(buy(N(buyera), FREE_PRICE, account("benef", i)));
+  }
+  BOOST_CHECK(!buy(N(buyera), FREE_PRICE, N(benefx)));
+  BOOST_CHECK(failed_with("5 affective orders at most for each buyer"));
+  // paid range of the same buyer is empty
+  BOOST_CHECK(buy(N(buyera), PAID_PRICE, N(benefx)));
+}
+
+BOOST_AUTO_TEST_CASE(migrate_moves_legacy_orders)
+{
+  add_paid(N(credita), 10000000);
+  legacyorder_table legacy(CODE_ACCOUNT, SCOPE);
+  for (uint64_t i = 0; i < 3; i++)
+  {
+    legacy.emplace(RAM_PAYER, [&](auto &o) {
+      o.id = i;
+      o.buyer = N(buyera);
+      o.price = asset(PAID_PRICE, EOS_SYMBOL);
+      o.is_free = FALSE;
+      o.creditor = N(credita);
+      o.beneficiary = account("benef", i);
+      o.plan_id = 1;
+      o.cpu_staked = asset(100000, EOS_SYMBOL);
+      o.net_staked = asset(10000, EOS_SYMBOL);
+      o.created_at = GENESIS - SECONDS_PER_DAY;
+      o.expire_at = GENESIS + (i + 1) * SECONDS_PER_DAY;
+    });
+  }
+  // stake of legacy orders is on creditor row already
+  creditor_table c(CODE_ACCOUNT, SCOPE);
+  c.modify(c.find(N(credita)), RAM_PAYER, [&](auto &i) {
+    i.cpu_staked += asset(300000, EOS_SYMBOL);
+    i.net_staked += asset(30000, EOS_SYMBOL);
+  });
+
+  BOOST_REQUIRE(push(N(migrate), pack(std::make_tuple(uint64_t(2)))));
+  BOOST_CHECK_EQUAL(std::distance(legacy.begin(), legacy.end()), 1);
+  BOOST_REQUIRE(push(N(migrate), pack(std::make_tuple(uint64_t(2)))));
+  BOOST_CHECK(legacy.begin() == legacy.end());
+
+  for (uint64_t i = 0; i < 3; i++)
+  {
+    auto orders = orders_of(account("benef", i));
+    BOOST_REQUIRE_EQUAL(orders.size(), 1u);
+    BOOST_CHECK_EQUAL(orders[0].expire_at, GENESIS + (i + 1) * SECONDS_PER_DAY);
+    BOOST_CHECK_EQUAL(get_order_scope(orders[0].id), get_partition_scope(get_partition(orders[0].expire_at)));
+  }
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).delegations, 3u);
+  BOOST_CHECK_EQUAL(get_metrics().paid_orders, 3u);
+
+  // expiry is scheduled again for moved orders
+  node.advance(GENESIS + 3 * SECONDS_PER_DAY + 60);
+  for (uint64_t i = 0; i < 3; i++)
+  {
+    BOOST_CHECK_EQUAL(orders_of(account("benef", i)).size(), 0u);
+  }
+  creditor after = get_creditor(N(credita));
+  BOOST_CHECK_EQUAL(after.delegations, 0u);
+  BOOST_CHECK_EQUAL(after.cpu_staked.amount, 0);
+  BOOST_CHECK_EQUAL(after.cpu_unstaked.amount, 300000);
+  BOOST_CHECK_EQUAL(get_metrics().paid_orders, 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(expiry_key_tests, bank_fixture)
+
+BOOST_AUTO_TEST_CASE(order_ids_follow_expiry)
+{
+  add_paid(N(credita), 10000000);
+  for (uint64_t i = 0; i < 4; i++)
+  {
+    mock::set_now(GENESIS + (3 - i) * 600);
+    BOOST_REQUIRE(buy(account("buyer", i), PAID_PRICE, account("benef", i)));
+  }
+  order_table o(CODE_ACCOUNT, get_partition_scope(get_partition(GENESIS + 7 * SECONDS_PER_DAY)));
+  std::vector<uint64_t> expire_at;
+  for (auto itr = o.begin(); itr != o.end(); itr++)
+  {
+    BOOST_CHECK_EQUAL(itr->id >> ORDER_SEQ_BITS, itr->expire_at);
+    expire_at.push_back(itr->expire_at);
+  }
+  BOOST_CHECK_EQUAL(expire_at.size(), 4u);
+  BOOST_CHECK(std::is_sorted(expire_at.begin(), expire_at.end()));
+  BOOST_CHECK_EQUAL(o.begin()->beneficiary, account("benef", 3));
+}
+
+BOOST_AUTO_TEST_CASE(check_expires_oldest_overdue_first)
+{
+  add_paid(N(credita), 10000000);
+  std::vector<order> orders;
+  for (uint64_t i = 0; i < 5; i++)
+  {
+    mock::set_now(GENESIS + i * 60);
+    BOOST_REQUIRE(buy(account("buyer", i), PAID_PRICE, account("benef", i)));
+    orders.push_back(orders_of(account("benef", i))[0]);
+  }
+  // deferred expiry of every order is late
+  mock::set_now(GENESIS + 7 * SECONDS_PER_DAY + 600);
+  BOOST_REQUIRE(push(N(check), pack(std::make_tuple(N(credita)))));
+
+  expirystat_table e(CODE_ACCOUNT, SCOPE);
+  BOOST_CHECK_EQUAL(e.get().backlog, 5u);
+  BOOST_CHECK_EQUAL(e.get().lag, now() - orders[0].expire_at);
+
+  // first batch replaces pending expiry of the oldest, later ones keep theirs
+  auto &deferred = mock::current().deferred;
+  auto batch = deferred.find(get_sender_id(orders[0].sender_id));
+  BOOST_REQUIRE(batch != deferred.end());
+  BOOST_CHECK_EQUAL(batch->second.deliver_at, now());
+  auto args = unpack<std::tuple<std::vector<uint64_t>, uint64_t>>(batch->second.actions[0].data);
+  BOOST_CHECK(std::get<0>(args) == std::vector<uint64_t>({orders[0].id, orders[1].id, orders[2].id}));
+  BOOST_CHECK(deferred.count(get_sender_id(orders[1].sender_id)) == 0);
+  BOOST_CHECK(deferred.count(get_sender_id(orders[3].sender_id)) == 1);
+
+  node.advance(now());
+  for (uint64_t i = 0; i < 5; i++)
+  {
+    BOOST_CHECK_EQUAL(orders_of(account("benef", i)).size(), 0u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(renewal_moves_order_key)
+{
+  add_paid(N(credita), 10000000);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  order first = orders_of(N(benefa))[0];
+  mock::set_now(GENESIS + 3600);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+
+  order renewed = orders_of(N(benefa))[0];
+  BOOST_CHECK_EQUAL(renewed.sender_id, first.sender_id);
+  BOOST_CHECK_EQUAL(renewed.id >> ORDER_SEQ_BITS, GENESIS + 14 * SECONDS_PER_DAY);
+  order_table old(CODE_ACCOUNT, get_order_scope(first.id));
+  BOOST_CHECK(old.find(first.id) == old.end());
+  orderidx_table x(CODE_ACCOUNT, SCOPE);
+  BOOST_CHECK_EQUAL(x.get(first.sender_id).order_id, renewed.id);
+
+  // first expiry date passes without expiring it
+  node.advance(GENESIS + 7 * SECONDS_PER_DAY + 60);
+  BOOST_CHECK_EQUAL(orders_of(N(benefa)).size(), 1u);
+  node.advance(GENESIS + 14 * SECONDS_PER_DAY + 60);
+  BOOST_CHECK_EQUAL(orders_of(N(benefa)).size(), 0u);
+  BOOST_CHECK(x.find(first.sender_id) == x.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// RAM of two delband rows besides what creditor uses anyway
+static const int64_t TWO_DELEGATIONS = CREDITOR_RAM_RESERVED + 2 * DELBAND_RAM_BYTES;
+
+BOOST_FIXTURE_TEST_SUITE(ram_headroom_tests, bank_fixture)
+
+BOOST_AUTO_TEST_CASE(creditor_without_headroom_is_skipped)
+{
+  set_shards(1, 2);
+  add_paid(N(credita), 10000000, true, TWO_DELEGATIONS);
+  add_paid(N(creditb), 10000000);
+  for (uint64_t i = 0; i < 6; i++)
+  {
+    BOOST_REQUIRE(buy(account("buyer", i), PAID_PRICE, account("benef", i)));
+  }
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).delegations, 2u);
+  BOOST_CHECK_EQUAL(get_creditor(N(creditb)).delegations, 4u);
+  BOOST_CHECK_EQUAL(node.failures.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(renewal_needs_no_headroom)
+{
+  add_paid(N(credita), 10000000, true, TWO_DELEGATIONS);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_REQUIRE(buy(N(buyerb), PAID_PRICE, N(benefb)));
+  BOOST_CHECK(!buy(N(buyerc), PAID_PRICE, N(benefc)));
+
+  // live delband row of benefa is reused
+  BOOST_CHECK(buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).delegations, 2u);
+  BOOST_CHECK_EQUAL(get_metrics().renewals, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(rotation_replaces_creditor_without_headroom)
+{
+  add_paid(N(credita), 10000000, true, TWO_DELEGATIONS);
+  add_paid(N(creditb), 10000000, false);
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).is_active, TRUE);
+  // check of the purchase taking its last delband row rotates it out
+  BOOST_REQUIRE(buy(N(buyerb), PAID_PRICE, N(benefb)));
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).is_active, FALSE);
+  BOOST_CHECK_EQUAL(get_creditor(N(creditb)).is_active, TRUE);
+  BOOST_CHECK_EQUAL(get_metrics().rotations, 1u);
+
+  BOOST_REQUIRE(buy(N(buyerc), PAID_PRICE, N(benefc)));
+  BOOST_CHECK_EQUAL(get_creditor(N(creditb)).delegations, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(reconcile_reads_ram_quota)
+{
+  add_paid(N(credita), 10000000, true, TWO_DELEGATIONS);
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).ram_bytes, TWO_DELEGATIONS);
+  userres_table u(EOSIO, N(credita));
+  u.modify(u.find(N(credita)), N(credita), [&](auto &r) { r.ram_bytes += 10 * DELBAND_RAM_BYTES; });
+  BOOST_REQUIRE(push(N(reconcile), pack(std::make_tuple(N(credita)))));
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).ram_bytes, TWO_DELEGATIONS + 10 * DELBAND_RAM_BYTES);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(creditor_migration_tests, bank_fixture)
+
+static void add_legacy_creditor(account_name account, int64_t balance)
+{
+  mock::set_balance(account, asset(balance, EOS_SYMBOL));
+  legacycreditor_table l(CODE_ACCOUNT, SCOPE);
+  l.emplace(RAM_PAYER, [&](auto &i) {
+    i.account = account;
+    i.is_active = TRUE;
+    i.for_free = FALSE;
+    i.balance = asset(balance, EOS_SYMBOL);
+    i.cpu_staked = asset(300000, EOS_SYMBOL);
+    i.net_staked = asset(30000, EOS_SYMBOL);
+    i.cpu_unstaked = asset(0, EOS_SYMBOL);
+    i.net_unstaked = asset(0, EOS_SYMBOL);
+    i.created_at = GENESIS - SECONDS_PER_DAY;
+    i.updated_at = GENESIS - 60;
+  });
+}
+
+BOOST_AUTO_TEST_CASE(migrate_rewrites_creditor_rows)
+{
+  add_legacy_creditor(N(credita), 10000000);
+  add_legacy_creditor(N(creditb), 20000000);
+  set_ram(N(creditb), TWO_DELEGATIONS);
+
+  // current rows are refused until old ones are converted
+  BOOST_CHECK_THROW(addcreditor(N(creditc), false, asset(10000000, EOS_SYMBOL)), mock::assertion);
+
+  BOOST_REQUIRE(push(N(migrate), pack(std::make_tuple(uint64_t(10)))));
+  legacycreditor_table l(CODE_ACCOUNT, SCOPE);
+  BOOST_CHECK(l.begin() == l.end());
+  creditor a = get_creditor(N(credita));
+  creditor b = get_creditor(N(creditb));
+  BOOST_CHECK_EQUAL(a.is_active, TRUE);
+  BOOST_CHECK_EQUAL(a.cpu_staked.amount, 300000);
+  BOOST_CHECK_EQUAL(a.available.amount, 10000000);
+  BOOST_CHECK_EQUAL(a.updated_at, GENESIS - 60);
+  BOOST_CHECK_EQUAL(a.ram_bytes, 0);
+  BOOST_CHECK_EQUAL(b.ram_bytes, TWO_DELEGATIONS);
+  BOOST_CHECK_EQUAL(b.delegations, 0u);
+
+  // converted once, later calls only move orders
+  BOOST_REQUIRE(push(N(migrate), pack(std::make_tuple(uint64_t(10)))));
+  BOOST_CHECK_EQUAL(get_creditor(N(credita)).available.amount, 10000000);
+  BOOST_CHECK_NO_THROW(addcreditor(N(creditc), false, asset(10000000, EOS_SYMBOL)));
+  BOOST_REQUIRE(buy(N(buyera), PAID_PRICE, N(benefa)));
+  BOOST_CHECK_EQUAL(orders_of(N(benefa))[0].creditor, N(credita));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
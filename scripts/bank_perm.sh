@@ -10,6 +10,7 @@ cleos set account permission $ACCOUNT bankperm '{"threshold": 1,"keys": [{"key":
 cleos set action permission $ACCOUNT eosio.token transfer bankperm -p $ACCOUNT@active
 cleos set action permission $ACCOUNT eosio delegatebw bankperm -p $ACCOUNT@active
 cleos set action permission $ACCOUNT eosio undelegatebw bankperm -p $ACCOUNT@active
+cleos set action permission $ACCOUNT bankofstaked expire bankperm -p $ACCOUNT@active
 cleos set action permission $ACCOUNT bankofstaked expireorder bankperm -p $ACCOUNT@active
 cleos set action permission $ACCOUNT bankofstaked check bankperm -p $ACCOUNT@active
 cleos set action permission $ACCOUNT bankofstaked rotate bankperm -p $ACCOUNT@active
@@ -14,3 +14,4 @@ else
   cleos set action permission $ACCOUNT eosio delegatebw creditorperm -p $ACCOUNT@active
 fi
 cleos set action permission $ACCOUNT eosio undelegatebw creditorperm -p $ACCOUNT@active
+cleos set action permission $ACCOUNT eosio refund creditorperm -p $ACCOUNT@active
@@ -4,6 +4,10 @@ cleos -u $API system newaccount voter3 bankofstaked EOS6MRyAjQq8ud7hVNYcfnVPJqcV
 sleep 1
 cleos -u $API set contract bankofstaked bankofstaked
 sleep 1
+cleos -u $API system newaccount voter3 bankadmin EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV --stake-cpu "100 EOS" --stake-net "100 EOS" --buy-ram "100 EOS"
+sleep 1
+cleos -u $API set contract bankadmin bankofstaked bankadmin.wasm bankadmin.abi
+sleep 1
 cleos -u $API system newaccount voter3 stakedincome EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV --buy-ram "100 EOS" --stake-cpu "100 EOS" --stake-net "100 EOS"
 sleep 1
 cleos -u $API system newaccount voter3 masktransfer EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV --buy-ram "100 EOS" --stake-cpu "100 EOS" --stake-net "100 EOS"
@@ -32,19 +36,19 @@ cleos -u $API push action bankofstaked activate '{"account": "voter1"}' -p banko
 sleep 1
 cleos -u $API push action bankofstaked activate '{"account": "voter2"}' -p bankofstaked
 sleep 1
-cleos -u $API push action bankofstaked addsafeacnt '{"account": "voter1"}' -p bankofstaked
+cleos -u $API push action bankadmin addsafeacnt '{"account": "voter1"}' -p bankadmin
 sleep 1
 
-cleos -u $API push action bankofstaked setplan '{"price": "0.1000 EOS", "cpu": "0.5000 EOS", "net": "0.5000 EOS", "duration": 1, "is_free": true}' -p bankofstaked
+cleos -u $API push action bankadmin setplan '{"price": "0.1000 EOS", "cpu": "0.5000 EOS", "net": "0.5000 EOS", "duration": 1, "is_free": true}' -p bankadmin
 sleep 1
-cleos -u $API push action bankofstaked setplan '{"price": "0.2000 EOS", "cpu": "36.0000 EOS", "net": "4.0000 EOS", "duration": 1, "is_free": false}' -p bankofstaked
+cleos -u $API push action bankadmin setplan '{"price": "0.2000 EOS", "cpu": "36.0000 EOS", "net": "4.0000 EOS", "duration": 1, "is_free": false}' -p bankadmin
 sleep 1
-cleos -u $API push action bankofstaked activateplan '{"price": "0.1000 EOS", "is_active": true}' -p bankofstaked
+cleos -u $API push action bankadmin activateplan '{"price": "0.1000 EOS", "is_active": true}' -p bankadmin
 sleep 1
-cleos -u $API push action bankofstaked activateplan '{"price": "0.2000 EOS", "is_active": true}' -p bankofstaked
+cleos -u $API push action bankadmin activateplan '{"price": "0.2000 EOS", "is_active": true}' -p bankadmin
 sleep 1
 
 
 # add voter3 to whitelist table
-cleos -u $API push action bankofstaked addwhitelist '{"account": "voter3", "capacity": 1000}' -p bankofstaked
+cleos -u $API push action bankadmin addwhitelist '{"account": "voter3", "capacity": 1000}' -p bankadmin
 sleep 1
@@ -9,10 +9,20 @@ v=921459758687; k=order; declare "table_$k=$v";
 v=921459758687; k=freelock; declare "table_$k=$v";
 v=921459758687; k=blacklist; declare "table_$k=$v";
 v=921459758687; k=whitelist; declare "table_$k=$v";
-v=bankofstaked; k=plan; declare "table_$k=$v";
+v=921459758687; k=config; declare "table_$k=$v";
+v=921459758687; k=rotation; declare "table_$k=$v";
+v=921459758687; k=expirystat; declare "table_$k=$v";
+v=921459758687; k=metrics; declare "table_$k=$v";
+v=921459758687; k=orderdir; declare "table_$k=$v";
+v=921459758687; k=orderidx; declare "table_$k=$v";
+v=921459758687; k=migration; declare "table_$k=$v";
+v=921459758687; k=refunding; declare "table_$k=$v";
+v=bankadmin; k=plan; declare "table_$k=$v";
+v=bankadmin; k=plandir; declare "table_$k=$v";
 
 
-for name in creditor safecreditor plan order history freelock blacklist whitelist
+# orders of partition p are in scope 921459758687 + p, see orderdir for live partitions
+for name in creditor order orderdir orderidx history freelock refunding rotation expirystat metrics migration
 do
   echo "==============TABLE "$name"========"
   scope="table_$name"
@@ -20,3 +30,13 @@ do
   echo "------------------------------------"
   echo
 done
+
+# tables written by admin actions belong to bankadmin
+for name in safecreditor plan plandir blacklist whitelist config
+do
+  echo "==============TABLE "$name"========"
+  scope="table_$name"
+  cleos -u $API get table bankadmin ${!scope} $name -l " $limit"
+  echo "------------------------------------"
+  echo
+done
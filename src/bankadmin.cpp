@@ -0,0 +1,396 @@
+// admin contract of bankofstaked, deployed on ADMIN_ACCOUNT.
+// plans, config, whitelist, blacklist and safe creditors are written here,
+// bankofstaked reads them on the purchase path, see include/bankofstaked/bankofstaked.hpp
+#include <../include/bankofstaked/bankofstaked.hpp>
+#include <settings.cpp>
+
+// native builds link both contracts into one binary, see native/contracts.hpp
+#ifndef ADMIN_APPLY
+#define ADMIN_APPLY apply
+#endif
+
+using namespace eosio;
+using namespace bank;
+using namespace utils;
+using namespace validation;
+
+class bankadmin : contract
+{
+
+public:
+  using contract::contract;
+  bankadmin(name self) : contract(self) {}
+
+  // @abi action addwhitelist
+  void addwhitelist(account_name account, uint64_t capacity)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    whitelist_table w(ADMIN_ACCOUNT, SCOPE);
+    set_whitelist(w, account, capacity);
+  }
+
+  // @abi action setwhitelist
+  void setwhitelist(std::vector<whitelistparam> entries)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    validate_sorted(entries, [](const whitelistparam &e) { return e.account; });
+    whitelist_table w(ADMIN_ACCOUNT, SCOPE);
+    for(int i=0; i<entries.size(); i++)
+    {
+      if(entries[i].capacity > 0)
+      {
+        set_whitelist(w, entries[i].account, entries[i].capacity);
+        continue;
+      }
+      auto itr = w.find(entries[i].account);
+      if(itr != w.end())
+      {
+        w.erase(itr);
+      }
+    }
+  }
+
+  // @abi action delwhitelist
+  void delwhitelist(account_name account, uint64_t capacity)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    whitelist_table w(ADMIN_ACCOUNT, SCOPE);
+    auto itr = w.find(account);
+    eosio_assert(itr != w.end(), "account not found in whitelist table");
+    //delelete whitelist entry
+    w.erase(itr);
+  }
+
+  // @abi action addsafeacnt
+  void addsafeacnt(account_name account)
+  {
+    require_auth(ADMIN_ACCOUNT);
+
+    validate_creditor(account);
+
+    safecreditor_table s(ADMIN_ACCOUNT, SCOPE);
+    s.emplace(ADMIN_RAM_PAYER, [&](auto &i) {
+      i.account = account;
+      i.created_at = now();
+      i.updated_at = now();
+    });
+  }
+
+  // @abi action delsafeacnt
+  void delsafeacnt(account_name account)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    safecreditor_table s(ADMIN_ACCOUNT, SCOPE);
+    auto itr = s.find(account);
+    eosio_assert(itr != s.end(), "account does not exist in safecreditor table");
+    s.erase(itr);
+  }
+
+  // @abi action addblacklist
+  void addblacklist(account_name account)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    blacklist_table b(ADMIN_ACCOUNT, SCOPE);
+    auto itr = b.find(account);
+    eosio_assert(itr == b.end(), "account already exist in blacklist table");
+
+    // add entry
+    b.emplace(ADMIN_RAM_PAYER, [&](auto &i) {
+      i.account = account;
+      i.created_at = now();
+    });
+  }
+
+
+  // @abi action setblacklist
+  void setblacklist(std::vector<account_name> accounts, bool blacklisted)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    validate_sorted(accounts, [](account_name a) { return a; });
+    blacklist_table b(ADMIN_ACCOUNT, SCOPE);
+    //accounts already in place are skipped
+    for(int i=0; i<accounts.size(); i++)
+    {
+      auto itr = b.find(accounts[i]);
+      if(blacklisted && itr == b.end())
+      {
+        b.emplace(ADMIN_RAM_PAYER, [&](auto &e) {
+          e.account = accounts[i];
+          e.created_at = now();
+        });
+      }
+      else if(!blacklisted && itr != b.end())
+      {
+        b.erase(itr);
+      }
+    }
+  }
+
+
+  // @abi action delblacklist
+  void delblacklist(account_name account)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    blacklist_table b(ADMIN_ACCOUNT, SCOPE);
+
+    //make sure specified blacklist account exists
+    auto itr = b.find(account);
+    eosio_assert(itr!= b.end(), "account not found in blacklist table");
+    //delelete entry
+    b.erase(itr);
+  }
+
+  // @abi action setconfig
+  void setconfig(uint64_t free_shards,
+                 uint64_t paid_shards,
+                 uint64_t rotate_depth,
+                 uint64_t high_watermark,
+                 uint64_t lag_threshold,
+                 uint64_t max_batch)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    eosio_assert(free_shards > 0 && free_shards <= MAX_SHARDS, "free_shards should between 1 and 16");
+    eosio_assert(paid_shards > 0 && paid_shards <= MAX_SHARDS, "paid_shards should between 1 and 16");
+    eosio_assert(rotate_depth > 0, "rotate_depth should be positive");
+    eosio_assert(high_watermark >= 100, "high_watermark should be at least 100");
+    eosio_assert(max_batch >= CHECK_MAX_DEPTH && max_batch <= MAX_EXPIRY_BATCH, "max_batch should between 3 and 50");
+
+    config_table cfg(ADMIN_ACCOUNT, SCOPE);
+    config c = get_config();
+    c.free_shards = free_shards;
+    c.paid_shards = paid_shards;
+    c.rotate_depth = rotate_depth;
+    c.high_watermark = high_watermark;
+    c.lag_threshold = lag_threshold;
+    c.max_batch = max_batch;
+    cfg.set(c, ADMIN_RAM_PAYER);
+  }
+
+
+  // @abi action setplan
+  void setplan(asset price,
+               asset cpu,
+               asset net,
+               uint64_t duration,
+               bool is_free)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    plan_table p(ADMIN_ACCOUNT, ADMIN_ACCOUNT);
+    auto plans = get_plans();
+    //new plan is inactive until activateplan, existing plan keeps its state
+    auto found = find_plan(plans, price.amount);
+    uint64_t is_active = found == plans.end() ? FALSE : found->is_active;
+    set_plan(p, plans, price, cpu, net, duration, is_free, is_active);
+    save_plans();
+  }
+
+  // @abi action setplans
+  void setplans(std::vector<planparam> plans)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    validate_sorted(plans, [](const planparam &p) { return p.price.amount; });
+    plan_table p(ADMIN_ACCOUNT, ADMIN_ACCOUNT);
+    auto existing = get_plans();
+    for(int i=0; i<plans.size(); i++)
+    {
+      set_plan(p, existing, plans[i].price, plans[i].cpu, plans[i].net, plans[i].duration, plans[i].is_free,
+               plans[i].is_active?TRUE:FALSE);
+    }
+    //plandir is written once for the whole batch
+    save_plans();
+  }
+  
+  // @abi action activateplan
+  void activateplan(asset price, bool is_active)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    eosio_assert(price.is_valid(), "invalid price");
+    plan_table p(ADMIN_ACCOUNT, ADMIN_ACCOUNT);
+    auto plans = get_plans();
+    auto found = find_plan(plans, price.amount);
+    eosio_assert(found != plans.end(), "price not found");
+
+    p.modify(p.find(found->id), ADMIN_RAM_PAYER, [&](auto &i) {
+     i.is_active = is_active?TRUE:FALSE;
+     i.updated_at = now();
+    });
+    save_plans();
+  }
+
+  //copy config, plans, safecreditor, blacklist and whitelist rows bankofstaked wrote before the split.
+  //config and plans are copied by the first call, then at most max_depth rows of the other tables
+  //by each call, resuming where the last one stopped. rows bankadmin already has are kept
+  // @abi action migrate
+  void migrate(uint64_t max_depth)
+  {
+    require_auth(ADMIN_ACCOUNT);
+    rowmigration_table m(ADMIN_ACCOUNT, SCOPE);
+    rowmigration state = m.get_or_default(rowmigration{0, 0});
+    eosio_assert(state.step < ROWS_MIGRATED, "rows are migrated already");
+
+    if(state.step == 0)
+    {
+      migrate_settings();
+      state.step = 1;
+    }
+    uint64_t depth = 0;
+    while(state.step < ROWS_MIGRATED && depth < max_depth)
+    {
+      bool done = false;
+      if(state.step == 1) {
+        done = copy_rows<safecreditor_table>(state.cursor, max_depth, depth);
+      } else if(state.step == 2) {
+        done = copy_rows<blacklist_table>(state.cursor, max_depth, depth);
+      } else {
+        done = copy_rows<whitelist_table>(state.cursor, max_depth, depth);
+      }
+      if(done)
+      {
+        state.step += 1;
+        state.cursor = 0;
+      }
+    }
+    m.set(state, ADMIN_RAM_PAYER);
+  }
+
+  //entry point of bankadmin contract
+  void apply(account_name contract, account_name action)
+  {
+    if (contract != _self)
+      return;
+
+    auto &thiscontract = *this;
+    switch (action)
+    {
+      EOSIO_API(bankadmin,
+          (setplan)
+          (activateplan)
+          (setplans)
+          (addwhitelist)
+          (delwhitelist)
+          (setwhitelist)
+          (addsafeacnt)
+          (delsafeacnt)
+          (addblacklist)
+          (setblacklist)
+          (delblacklist)
+          (setconfig)
+          (migrate));
+    };
+  }
+
+private:
+
+  //add whitelist entry or update its capacity
+  void set_whitelist(whitelist_table &w, account_name account, uint64_t capacity)
+  {
+    auto itr = w.find(account);
+    if(itr == w.end()) {
+      w.emplace(ADMIN_RAM_PAYER, [&](auto &i) {
+        i.account = account;
+        i.capacity = capacity;
+        i.created_at = now();
+        i.updated_at = now();
+      });
+    } else {
+      w.modify(itr, ADMIN_RAM_PAYER, [&](auto &i) {
+        i.capacity = capacity;
+        i.updated_at = now();
+      });
+    }
+  }
+
+  //copy config and plans of bankofstaked, plans of a price bankadmin has already are skipped
+  void migrate_settings()
+  {
+    config_table old_cfg(CODE_ACCOUNT, SCOPE);
+    config_table cfg(ADMIN_ACCOUNT, SCOPE);
+    if(old_cfg.exists() && !cfg.exists())
+    {
+      cfg.set(old_cfg.get(), ADMIN_RAM_PAYER);
+    }
+
+    plan_table old_plans(CODE_ACCOUNT, CODE_ACCOUNT);
+    plan_table p(ADMIN_ACCOUNT, ADMIN_ACCOUNT);
+    auto existing = get_plans();
+    for(auto itr = old_plans.begin(); itr != old_plans.end(); itr++)
+    {
+      if(find_plan(existing, itr->price.amount) != existing.end())
+      {
+        continue;
+      }
+      p.emplace(ADMIN_RAM_PAYER, [&](auto &i) {
+        i = *itr;
+        i.id = p.available_primary_key();
+      });
+    }
+    save_plans();
+  }
+
+  //copy rows of Table after cursor from bankofstaked, returns true once its last row is copied
+  template<typename Table>
+  bool copy_rows(account_name &cursor, uint64_t max_depth, uint64_t &depth)
+  {
+    Table from(CODE_ACCOUNT, SCOPE);
+    Table to(ADMIN_ACCOUNT, SCOPE);
+    auto itr = from.upper_bound(cursor);
+    for(; itr != from.end() && depth < max_depth; itr++)
+    {
+      depth++;
+      cursor = itr->primary_key();
+      if(to.find(cursor) == to.end())
+      {
+        to.emplace(ADMIN_RAM_PAYER, [&](auto &i) {
+          i = *itr;
+        });
+      }
+    }
+    return itr == from.end();
+  }
+
+  //add plan of price or update it, existing plans are looked up in plans ordered by price
+  void set_plan(plan_table &p,
+                const std::vector<plan> &plans,
+                asset price,
+                asset cpu,
+                asset net,
+                uint64_t duration,
+                bool is_free,
+                uint64_t is_active)
+  {
+    validate_asset(price, cpu, net);
+    auto found = find_plan(plans, price.amount);
+    if (found == plans.end())
+    {
+      p.emplace(ADMIN_RAM_PAYER, [&](auto &i) {
+        i.id = p.available_primary_key();
+        i.price = price;
+        i.cpu = cpu;
+        i.net = net;
+        i.duration = duration;
+        i.is_active = is_active;
+        i.is_free = is_free?TRUE:FALSE;
+        i.created_at = now();
+        i.updated_at = now();
+      });
+      return;
+    }
+    p.modify(p.find(found->id), ADMIN_RAM_PAYER, [&](auto &i) {
+      i.cpu = cpu;
+      i.net = net;
+      i.duration = duration;
+      i.is_active = is_active;
+      i.is_free = is_free?TRUE:FALSE;
+      i.updated_at = now();
+    });
+  }
+};
+
+extern "C"
+{
+  [[noreturn]] void ADMIN_APPLY(uint64_t receiver, uint64_t code, uint64_t action) {
+    bankadmin c(receiver);
+    c.apply(code, action);
+    eosio_exit(0);
+  }
+}
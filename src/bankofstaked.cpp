@@ -1,13 +1,20 @@
+#include <../include/bankofstaked/profile.hpp>
 #include <eosiolib/currency.hpp>
 #include <eosiolib/transaction.hpp>
 #include <eosio.token/eosio.token.hpp>
 #include <eosio.system/eosio.system.hpp>
 #include <../include/bankofstaked/bankofstaked.hpp>
 #include <lock.cpp>
+#include <settings.cpp>
 #include <utils.cpp>
 #include <validation.cpp>
 #include <safedelegatebw.cpp>
 
+// native builds link both contracts into one binary, see native/contracts.hpp
+#ifndef BANK_APPLY
+#define BANK_APPLY apply
+#endif
+
 using namespace eosio;
 using namespace eosiosystem;
 using namespace bank;
@@ -42,55 +49,12 @@ public:
     }
   }
 
-  // DEBUG only, action to empty entires in both tables
-  // @abi action empty
-  void empty()
+  // drop freelock entries of day buckets ended before today
+  // @abi action sweeplocks
+  void sweeplocks(uint64_t max_depth)
   {
     require_auth(CODE_ACCOUNT);
-    /*
-    plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
-    while (p.begin() != p.end())
-    {
-      auto itr = p.end();
-      itr--;
-      p.erase(itr);
-      plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
-    }
-    order_table o(CODE_ACCOUNT, SCOPE);
-    while (o.begin() != o.end())
-    {
-      auto itr = o.end();
-      itr--;
-      o.erase(itr);
-      order_table o(CODE_ACCOUNT, SCOPE);
-    }
-
-    plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
-    while (p.begin() != p.end())
-    {
-      auto itr = p.end();
-      itr--;
-      p.erase(itr);
-      plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
-    }
-
-    creditor_table c(CODE_ACCOUNT, SCOPE);
-    while (c.begin() != c.end())
-    {
-      auto itr = c.end();
-      itr--;
-      c.erase(itr);
-      creditor_table c(CODE_ACCOUNT, SCOPE);
-    }
-    freelock_table c(CODE_ACCOUNT, SCOPE);
-    while (c.begin() != c.end())
-    {
-      auto itr = c.end();
-      itr--;
-      c.erase(itr);
-      freelock_table c(CODE_ACCOUNT, SCOPE);
-    }
-    */
+    expire_freelock(max_depth);
   }
 
   // @abi action test
@@ -100,9 +64,9 @@ public:
 
     validate_creditor(creditor);
 
-    plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
-    auto idx = p.get_index<N(price)>();
-    auto plan = idx.find(FREE_PLAN_AMOUNT);
+    auto plans = get_plans();
+    auto plan = find_plan(plans, FREE_PLAN_AMOUNT);
+    eosio_assert(plan != plans.end(), "free plan not found");
 
     //INLINE ACTION to test delegate CPU&NET for creditor itself
     if (is_safe_creditor(creditor)) {
@@ -133,163 +97,322 @@ public:
 
     validate_creditor(creditor);
 
-    order_table o(CODE_ACCOUNT, SCOPE);
-    uint64_t depth = 0;
+    config cfg = get_config();
+    expirystat stat = get_expirystat();
+    uint64_t backlog = 0;
+    uint64_t lag = 0;
     std::vector<uint64_t> order_ids;
 
-    // order ordered by expire_at
-    auto idx = o.get_index<N(expire_at)>();
-    auto itr = idx.begin();
-    //force expire at most CHECK_MAX_DEPTH orders
-    while (itr != idx.end() && depth < CHECK_MAX_DEPTH)
+    //overdue orders are in partitions up to today, oldest first.
+    //past partitions found empty are dropped from directory
+    orderdir dir = get_orderdir();
+    std::vector<uint64_t> live;
+    uint64_t today = get_partition(now());
+    bool done = false;
+    for(int i=0; i<dir.partitions.size(); i++)
     {
-      if(now() >= itr->expire_at) {
-        order_ids.emplace_back(itr->id);
+      uint64_t partition = dir.partitions[i];
+      if(done || partition > today)
+      {
+        live.emplace_back(partition);
+        continue;
       }
-      depth++;
-      itr++;
+      order_table o(CODE_ACCOUNT, get_partition_scope(partition));
+      // order ordered by expire_at
+      auto itr = o.begin();
+      if(itr == o.end() && partition < today)
+      {
+        continue;
+      }
+      live.emplace_back(partition);
+      //count at most max_batch overdue orders, force expire batch of them
+      while (itr != o.end() && backlog < cfg.max_batch && now() >= itr->expire_at)
+      {
+        if(backlog == 0) {
+          lag = now() - itr->expire_at;
+        }
+        if(order_ids.size() < stat.batch) {
+          order_ids.emplace_back(itr->id);
+        }
+        backlog++;
+        itr++;
+      }
+      // later partitions are not overdue past a live order
+      done = backlog >= cfg.max_batch || itr != o.end();
+    }
+    if(live.size() != dir.partitions.size())
+    {
+      dir.partitions = live;
+      save_orderdir(dir);
     }
-    undelegate(order_ids, 0);
+    undelegate(order_ids, 0, now());
+    update_expirystat(backlog, lag, cfg);
     expire_freelock();
-    rotate_creditor();
+    uint64_t rotations = rotate_creditor();
+    uint64_t refunds = mature_refunds(CHECK_MAX_DEPTH);
+
+    //most checks of purchases find nothing to do, metrics is only written by those which did something
+    if(order_ids.size() > 0 || rotations > 0 || refunds > 0)
+    {
+      metrics stats = get_metrics();
+      stats.checked_at = now();
+      save_metrics(stats);
+    }
+  }
+
+  //reconcile available and RAM quota of creditor with its token balance and eosio userres,
+  //purchases only look at the creditor entry
+  // @abi action reconcile
+  void reconcile(account_name creditor)
+  {
+    require_auth(CODE_ACCOUNT);
+
+    validate_creditor(creditor);
     update_balance(creditor);
   }
 
+  //convert creditors of earlier versions on the first call, then move at most max_depth orders
+  //left in scope SCOPE into partitions.
+  //their pending deferred expiry fails on the current expireorder, a new one is scheduled
+  // @abi action migrate
+  void migrate(uint64_t max_depth)
+  {
+    require_auth(CODE_ACCOUNT);
+
+    //creditors are converted all at once, before orders count their delegations
+    migration_table m(CODE_ACCOUNT, SCOPE);
+    if(!m.exists())
+    {
+      migrate_creditors();
+      m.set(migration{TRUE}, RAM_PAYER);
+    }
+
+    legacyorder_table legacy(CODE_ACCOUNT, SCOPE);
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    metrics stats = get_metrics();
+    uint64_t depth = 0;
+    auto itr = legacy.begin();
+    while (itr != legacy.end() && depth < max_depth)
+    {
+      depth++;
+      segment s;
+      s.creditor = itr->creditor;
+      s.plan_id = itr->plan_id;
+      s.price = itr->price;
+      s.cpu = itr->cpu_staked;
+      s.net = itr->net_staked;
+      s.created_at = itr->created_at;
+      s.expire_at = itr->expire_at;
+
+      order entry;
+      entry.buyer = itr->buyer;
+      entry.creditor = itr->creditor;
+      entry.beneficiary = itr->beneficiary;
+      entry.is_free = itr->is_free;
+      entry.created_at = itr->created_at;
+      entry.segments.emplace_back(s);
+      sum_segments(entry);
+      itr = legacy.erase(itr);
+
+      entry.id = new_order_id(entry.expire_at);
+      entry.sender_id = entry.id;
+      order_table o(CODE_ACCOUNT, get_order_scope(entry.id));
+      auto created = o.emplace(RAM_PAYER, [&](auto &i) {
+        i = entry;
+      });
+      add_order_index(*created);
+      schedule_expiry(entry.id);
+
+      // count order like a new one, so its expiry settles creditor and metrics
+      auto creditor_itr = c.find(entry.creditor);
+      if(creditor_itr != c.end()) {
+        c.modify(creditor_itr, RAM_PAYER, [&](auto &i) {
+          i.delegations += 1;
+        });
+      }
+      if(entry.is_free == TRUE) {
+        stats.free_orders += 1;
+      } else {
+        stats.paid_orders += 1;
+      }
+      stats.cpu_staked += entry.cpu_staked;
+      stats.net_staked += entry.net_staked;
+    }
+    save_metrics(stats);
+  }
+
   // @abi action forcexpire
   void forcexpire(const std::vector<uint64_t>& order_ids=std::vector<uint64_t>())
   {
     require_auth(CODE_ACCOUNT);
 
     //force expire provided orders
-    undelegate(order_ids, 0);
+    undelegate(order_ids, 0, EXPIRE_ALL);
     expire_freelock();
     rotate_creditor();
   }
 
+  // @abi action expire
+  void expire(const std::vector<uint64_t>& order_ids, uint64_t until)
+  {
+    require_auth(CODE_ACCOUNT);
+
+    std::vector<action> actions;
+    for(int i=0; i<order_ids.size(); i++)
+    {
+      order_table o(CODE_ACCOUNT, get_order_scope(order_ids[i]));
+      auto order = o.find(order_ids[i]);
+      // order might be expired already by check or forcexpire
+      if(order == o.end())
+      {
+        continue;
+      }
+      // expiry capped at MAX_EXPIRY_DELAY runs early, schedule the rest of it
+      if(until != EXPIRE_ALL && order->expire_at > now())
+      {
+        schedule_expiry(order->id);
+        continue;
+      }
+      append_expiry_actions(actions, *order, until);
+    }
+
+    //INLINE ACTIONS to undelegate and settle orders
+    for(int i=0; i<actions.size(); i++)
+    {
+      actions[i].send();
+    }
+  }
+
+  //expire segments of order with expire_at <= until,
+  //order entry is deleted once all its segments are expired
   // @abi action expireorder
-  void expireorder(uint64_t id)
+  void expireorder(uint64_t id, uint64_t until)
   {
     require_auth(CODE_ACCOUNT);
 
-    std::string content = "";
-    order_table o(CODE_ACCOUNT, SCOPE);
+    order_table o(CODE_ACCOUNT, get_order_scope(id));
     auto order = o.find(id);
     eosio_assert(order != o.end(), "order entry not found!!!");
 
-    //save order meta to history
-    //buyer|creditor|beneficiary|plan_id|price|cpu|net|created_at|expire_at
-    content += (name{order->buyer}).to_string();
-    content += "|" + (name{order->creditor}).to_string();
-    content += "|" + (name{order->beneficiary}).to_string();
-    content += "|" + std::to_string(order->plan_id);
-    content += "|" + std::to_string(order->price.amount);
-    content += order->is_free==TRUE?"|free":"|paid";
-    content += "|" + std::to_string(order->cpu_staked.amount);
-    content += "|" + std::to_string(order->net_staked.amount);
-    content += "|" + std::to_string(order->created_at);
-    content += "|" + std::to_string(order->expire_at);
-
-    // updated cpu_staked/net_staked/cpu_unstaked/net_unstaked of creditor entry
-    creditor_table c(CODE_ACCOUNT, SCOPE);
-    auto creditor_itr = c.find(order->creditor);
-    c.modify(creditor_itr, RAM_PAYER, [&](auto &i) {
-      i.cpu_staked -= order->cpu_staked;
-      i.net_staked -= order->net_staked;
-      i.cpu_unstaked += order->cpu_staked;
-      i.net_unstaked += order->net_staked;
-      i.balance = get_balance(order->creditor);
-      i.updated_at = now();
-    });
-
-    //delete order entry
-    o.erase(order);
-
-    // save order mete data to history table
+    // expired cpu&net summed up by creditor
+    std::vector<segment> legs;
+    std::vector<segment> remaining;
+    metrics stats = get_metrics();
     history_table h(CODE_ACCOUNT, SCOPE);
-    h.emplace(RAM_PAYER, [&](auto &i) {
-      i.id = h.available_primary_key();
-      i.content = content;
-      i.created_at = now();
-    });
-  }
+    for(int i=0; i<order->segments.size(); i++)
+    {
+      const segment &s = order->segments[i];
+      if(s.expire_at > until)
+      {
+        remaining.emplace_back(s);
+        continue;
+      }
+      add_to_legs(legs, s);
+      record_expiry_lag(s.expire_at);
+      // segments of orders created before metrics was introduced are not counted
+      stats.cpu_staked = stats.cpu_staked > s.cpu ? stats.cpu_staked - s.cpu : asset(0, EOS_SYMBOL);
+      stats.net_staked = stats.net_staked > s.net ? stats.net_staked - s.net : asset(0, EOS_SYMBOL);
+      if(order->is_free == TRUE) {
+        stats.free_expired += 1;
+      } else {
+        stats.paid_expired += 1;
+      }
 
-  // @abi action addwhitelist
-  void addwhitelist(account_name account, uint64_t capacity)
-  {
-    require_auth(CODE_ACCOUNT);
-    whitelist_table w(CODE_ACCOUNT, SCOPE);
-    auto itr = w.find(account);
-    if(itr == w.end()) {
-      w.emplace(RAM_PAYER, [&](auto &i) {
-        i.account = account;
-        i.capacity = capacity;
+      //save segment meta to history
+      //buyer|creditor|beneficiary|plan_id|price|cpu|net|created_at|expire_at
+      std::string content = "";
+      content += (name{order->buyer}).to_string();
+      content += "|" + (name{s.creditor}).to_string();
+      content += "|" + (name{order->beneficiary}).to_string();
+      content += "|" + std::to_string(s.plan_id);
+      content += "|" + std::to_string(s.price.amount);
+      content += order->is_free==TRUE?"|free":"|paid";
+      content += "|" + std::to_string(s.cpu.amount);
+      content += "|" + std::to_string(s.net.amount);
+      content += "|" + std::to_string(s.created_at);
+      content += "|" + std::to_string(s.expire_at);
+
+      // save order mete data to history table
+      h.emplace(RAM_PAYER, [&](auto &i) {
+        i.id = h.available_primary_key();
+        i.content = content;
         i.created_at = now();
-        i.updated_at = now();
       });
-    } else {
-      w.modify(itr, RAM_PAYER, [&](auto &i) {
-        i.capacity = capacity;
+    }
+
+    // updated cpu_staked/net_staked/cpu_unstaked/net_unstaked of creditor entries,
+    // delegation of a creditor ends once none of its segments remain
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    for(int j=0; j<legs.size(); j++)
+    {
+      bool ended = true;
+      for(int k=0; k<remaining.size(); k++)
+      {
+        if(remaining[k].creditor == legs[j].creditor) {
+          ended = false;
+          break;
+        }
+      }
+      auto creditor_itr = c.find(legs[j].creditor);
+      c.modify(creditor_itr, RAM_PAYER, [&](auto &i) {
+        i.cpu_staked -= legs[j].cpu;
+        i.net_staked -= legs[j].net;
+        i.cpu_unstaked += legs[j].cpu;
+        i.net_unstaked += legs[j].net;
+        i.balance = get_balance(legs[j].creditor);
+        if(ended && i.delegations > 0) {
+          i.delegations -= 1;
+        }
         i.updated_at = now();
       });
+      add_refunding(legs[j].creditor, legs[j].cpu, legs[j].net);
     }
-  }
 
-  // @abi action delwhitelist
-  void delwhitelist(account_name account, uint64_t capacity)
-  {
-    require_auth(CODE_ACCOUNT);
-    whitelist_table w(CODE_ACCOUNT, SCOPE);
-    auto itr = w.find(account);
-    eosio_assert(itr != w.end(), "account not found in whitelist table");
-    //delelete whitelist entry
-    w.erase(itr);
-  }
+    if(remaining.size() == 0)
+    {
+      // orders created before metrics was introduced are not counted
+      if(order->is_free == TRUE && stats.free_orders > 0) {
+        stats.free_orders -= 1;
+      } else if(order->is_free == FALSE && stats.paid_orders > 0) {
+        stats.paid_orders -= 1;
+      }
+      save_metrics(stats);
 
-  // @abi action addcreditor
-  void addcreditor(account_name account, uint64_t for_free, std::string free_memo)
-  {
-    require_auth(CODE_ACCOUNT);
-    creditor_table c(CODE_ACCOUNT, SCOPE);
-    auto itr = c.find(account);
-    eosio_assert(itr == c.end(), "account already exist in creditor table");
+      //delete order entry
+      remove_order_index(order->sender_id);
+      o.erase(order);
+      return;
+    }
+    save_metrics(stats);
 
-    c.emplace(RAM_PAYER, [&](auto &i) {
-      i.is_active = FALSE;
-      i.for_free = for_free?TRUE:FALSE;
-      i.free_memo = for_free?free_memo:"";
-      i.account = account;
-      i.balance = get_balance(account);
-      i.created_at = now();
-      i.updated_at = 0; // set to 0 for creditor auto rotation
+    //keep live segments, schedule expiry of the next one
+    uint64_t order_id = update_order(id, [&](auto &i) {
+      i.segments = remaining;
+      sum_segments(i);
     });
+    schedule_expiry(order_id);
   }
 
-  // @abi action addsafeacnt
-  void addsafeacnt(account_name account)
+  // @abi action addcreditor
+  void addcreditor(account_name account, uint64_t for_free, std::string free_memo)
   {
     require_auth(CODE_ACCOUNT);
-
-    validate_creditor(account);
-
-    safecreditor_table s(CODE_ACCOUNT, SCOPE);
-    s.emplace(RAM_PAYER, [&](auto &i) {
-      i.account = account;
-      i.created_at = now();
-      i.updated_at = now();
-    });
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    add_creditor(c, account, for_free, free_memo);
   }
 
-  // @abi action delsafeacnt
-  void delsafeacnt(account_name account)
+  // @abi action addcreditors
+  void addcreditors(std::vector<creditorparam> creditors)
   {
     require_auth(CODE_ACCOUNT);
-    safecreditor_table s(CODE_ACCOUNT, SCOPE);
-    auto itr = s.find(account);
-    eosio_assert(itr != s.end(), "account does not exist in safecreditor table");
-    s.erase(itr);
+    validate_sorted(creditors, [](const creditorparam &c) { return c.account; });
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    for(int i=0; i<creditors.size(); i++)
+    {
+      add_creditor(c, creditors[i].account, creditors[i].for_free, creditors[i].free_memo);
+    }
   }
 
-
   // @abi action delcreditor
   void delcreditor(account_name account)
   {
@@ -303,36 +426,6 @@ public:
   }
 
 
-  // @abi action addblacklist
-  void addblacklist(account_name account)
-  {
-    require_auth(CODE_ACCOUNT);
-    blacklist_table b(CODE_ACCOUNT, SCOPE);
-    auto itr = b.find(account);
-    eosio_assert(itr == b.end(), "account already exist in blacklist table");
-
-    // add entry
-    b.emplace(RAM_PAYER, [&](auto &i) {
-      i.account = account;
-      i.created_at = now();
-    });
-  }
-
-
-  // @abi action delblacklist
-  void delblacklist(account_name account)
-  {
-    require_auth(CODE_ACCOUNT);
-    blacklist_table b(CODE_ACCOUNT, SCOPE);
-
-    //make sure specified blacklist account exists
-    auto itr = b.find(account);
-    eosio_assert(itr!= b.end(), "account not found in blacklist table");
-    //delelete entry
-    b.erase(itr);
-  }
-
-
   // @abi action activate
   void activate(account_name account)
   {
@@ -340,62 +433,6 @@ public:
     activate_creditor(account);
   }
 
-
-  // @abi action setplan
-  void setplan(asset price,
-               asset cpu,
-               asset net,
-               uint64_t duration,
-               bool is_free)
-  {
-    require_auth(CODE_ACCOUNT);
-    validate_asset(price, cpu, net);
-    plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
-    auto idx = p.get_index<N(price)>();
-    auto itr = idx.find(price.amount);
-    if (itr == idx.end())
-    {
-      p.emplace(RAM_PAYER, [&](auto &i) {
-        i.id = p.available_primary_key();
-        i.price = price;
-        i.cpu = cpu;
-        i.net = net;
-        i.duration = duration;
-        i.is_active = FALSE;
-        i.is_free = is_free?TRUE:FALSE;
-        i.created_at = now();
-        i.updated_at = now();
-      });
-    }
-    else
-    {
-      idx.modify(itr, RAM_PAYER, [&](auto &i) {
-        i.cpu = cpu;
-        i.net = net;
-        i.duration = duration;
-        i.is_free = is_free?TRUE:FALSE;
-        i.updated_at = now();
-      });
-    }
-  }
-  
-  // @abi action activateplan
-  void activateplan(asset price, bool is_active)
-  {
-    require_auth(CODE_ACCOUNT);
-    eosio_assert(price.is_valid(), "invalid price");
-    plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
-    auto idx = p.get_index<N(price)>();
-    auto itr = idx.find(price.amount);
-    eosio_assert(itr != idx.end(), "price not found");
-
-    idx.modify(itr, RAM_PAYER, [&](auto &i) {
-     i.is_active = is_active?TRUE:FALSE;
-     i.updated_at = now();
-    });
-  }
-
-
   //entry point of bankofstaked contract
   void apply(account_name contract, account_name action)
   {
@@ -412,32 +449,189 @@ public:
     switch (action)
     {
       EOSIO_API(bankofstaked,
-          (empty)
-          (setplan)
-          (activateplan)
+          (expire)
           (expireorder)
-          (addwhitelist)
-          (delwhitelist)
           (addcreditor)
-          (addsafeacnt)
-          (delsafeacnt)
+          (addcreditors)
           (delcreditor)
-          (addblacklist)
-          (delblacklist)
           (activate)
           (check)
+          (reconcile)
+          (migrate)
           (test)
           (rotate)
           (clearhistory)
+          (sweeplocks)
           (forcexpire));
     };
   }
 
 private:
 
-  //undelegate Orders specified by order_ids
-  //deferred(if duration > 0) transaction to auto undelegate after expired
-  void undelegate(const std::vector<uint64_t>& order_ids=std::vector<uint64_t>(), uint64_t duration=0)
+  //add creditor, inactive until activated
+  void add_creditor(creditor_table &c, account_name account, uint64_t for_free, const std::string &free_memo)
+  {
+    //creditors of earlier versions are converted before rows of current layout are added
+    migration_table m(CODE_ACCOUNT, SCOPE);
+    if(!m.exists())
+    {
+      legacycreditor_table l(CODE_ACCOUNT, SCOPE);
+      eosio_assert(l.begin() == l.end(), "run migrate before adding creditors");
+      m.set(migration{TRUE}, RAM_PAYER);
+    }
+
+    auto itr = c.find(account);
+    eosio_assert(itr == c.end(), "account already exist in creditor table");
+
+    c.emplace(RAM_PAYER, [&](auto &i) {
+      i.is_active = FALSE;
+      i.for_free = for_free?TRUE:FALSE;
+      i.free_memo = for_free?free_memo:"";
+      i.account = account;
+      i.balance = get_balance(account);
+      i.available = i.balance;
+      i.ram_bytes = get_ram_bytes(account);
+      i.delegations = 0;
+      i.created_at = now();
+      i.updated_at = 0; // set to 0 for creditor auto rotation
+    });
+  }
+
+  //rewrite creditors of earlier layout in current one, available is their balance until reconciled.
+  //delegations of their orders are counted as the orders are migrated
+  void migrate_creditors()
+  {
+    legacycreditor_table l(CODE_ACCOUNT, SCOPE);
+    std::vector<legacycreditor> legacy;
+    auto itr = l.begin();
+    while(itr != l.end())
+    {
+      legacy.emplace_back(*itr);
+      itr = l.erase(itr);
+    }
+
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    for(int k=0; k<legacy.size(); k++)
+    {
+      const legacycreditor &old = legacy[k];
+      c.emplace(RAM_PAYER, [&](auto &i) {
+        i.account = old.account;
+        i.is_active = old.is_active;
+        i.for_free = old.for_free;
+        i.free_memo = old.free_memo;
+        i.balance = old.balance;
+        i.cpu_staked = old.cpu_staked;
+        i.net_staked = old.net_staked;
+        i.cpu_unstaked = old.cpu_unstaked;
+        i.net_unstaked = old.net_unstaked;
+        i.created_at = old.created_at;
+        i.updated_at = old.updated_at;
+        i.available = old.balance;
+        i.ram_bytes = get_ram_bytes(old.account);
+        i.delegations = 0;
+      });
+    }
+  }
+
+  //sum up price, cpu and net of segment into leg of the same creditor
+  void add_to_legs(std::vector<segment> &legs, const segment &s)
+  {
+    for(int i=0; i<legs.size(); i++)
+    {
+      if(legs[i].creditor == s.creditor)
+      {
+        legs[i].price += s.price;
+        legs[i].cpu += s.cpu;
+        legs[i].net += s.net;
+        return;
+      }
+    }
+    legs.emplace_back(s);
+  }
+
+  //build undelegatebw, expireorder and income transfer actions
+  //for segments of order with expire_at <= until, one undelegatebw for each creditor
+  void append_expiry_actions(std::vector<action> &actions, const order &order, uint64_t until)
+  {
+    std::vector<segment> legs;
+    for(int i=0; i<order.segments.size(); i++)
+    {
+      if(order.segments[i].expire_at <= until)
+      {
+        add_to_legs(legs, order.segments[i]);
+      }
+    }
+    // nothing to expire, e.g. segment renewed after expiry was scheduled
+    if(legs.size() == 0)
+    {
+      return;
+    }
+
+    // undelegatebw actions
+    for(int i=0; i<legs.size(); i++)
+    {
+      action act1 = action(
+        permission_level{ legs[i].creditor, N(creditorperm) },
+        N(eosio), N(undelegatebw),
+        std::make_tuple(legs[i].creditor, order.beneficiary, legs[i].net, legs[i].cpu)
+      );
+      actions.emplace_back(act1);
+    }
+    //delete order entry
+    action act2 = action(
+      permission_level{ CODE_ACCOUNT, N(bankperm) },
+      CODE_ACCOUNT, N(expireorder),
+      std::make_tuple(order.id, until)
+    );
+    actions.emplace_back(act2);
+
+    //if order is_free is not free, transfer income to creditors
+    if (order.is_free == FALSE)
+    {
+      for(int i=0; i<legs.size(); i++)
+      {
+        asset price = legs[i].price;
+        auto username = name{legs[i].creditor};
+        std::string recipient_name = username.to_string();
+        std::string memo = recipient_name + " bankofstaked income";
+
+        // transfer income to creditor,
+        // eosio.token rejects a transfer of 0, which would abort the whole expiry
+        asset income = get_income(legs[i].creditor, price);
+        eosio_assert(income <= price, "income should not be greater than price");
+        if(income.amount > 0)
+        {
+          action act3 = action(
+            permission_level{ CODE_ACCOUNT, N(bankperm) },
+            N(eosio.token), N(transfer),
+            std::make_tuple(CODE_ACCOUNT, MASK_TRANSFER, income, memo)
+          );
+          actions.emplace_back(act3);
+        }
+
+        // transfer reserved fund to STAKED_INCOME
+        asset reserved = price - income;
+        eosio_assert(reserved <= price, "reserved should not be greater than price");
+        if(reserved.amount > 0)
+        {
+          username = name{STAKED_INCOME};
+          recipient_name = username.to_string();
+          memo = recipient_name + " bankofstaked reserved";
+          action act4 = action(
+            permission_level{ CODE_ACCOUNT, N(bankperm) },
+            N(eosio.token), N(transfer),
+            std::make_tuple(CODE_ACCOUNT, MASK_TRANSFER, reserved, memo)
+          );
+          actions.emplace_back(act4);
+        }
+      }
+    }
+  }
+
+  //undelegate segments(expire_at <= until) of Orders specified by order_ids
+  //deferred(if delay > 0, in seconds) transaction to auto undelegate after expired
+  //otherwise orders are expired right away and their pending deferred expiry is cancelled
+  void undelegate(const std::vector<uint64_t>& order_ids=std::vector<uint64_t>(), uint64_t delay=0, uint64_t until=EXPIRE_ALL)
   {
     if(order_ids.size() == 0) 
     {
@@ -445,72 +639,192 @@ private:
     }
     eosio::transaction out;
 
-    order_table o(CODE_ACCOUNT, SCOPE);
-    plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
-
-    uint64_t nonce = 0;
+    uint128_t sender_id = 0;
+    // expiry later than MAX_EXPIRY_DELAY is sent as `expire`, which schedules it again when it runs
+    bool compact = COMPACT_EXPIRY == TRUE || delay > MAX_EXPIRY_DELAY;
 
     for(int i=0; i<order_ids.size(); i++)
     {
       uint64_t order_id = order_ids[i];
-      nonce += order_id;
-      // get order entry
+      // make sure order entry exists
+      order_table o(CODE_ACCOUNT, get_order_scope(order_id));
       auto order = o.get(order_id);
+      if (i == 0)
+      {
+        sender_id = get_sender_id(order.sender_id);
+      }
+      // forced or batch expiry, drop the deferred expiry still pending for this order
+      if (delay == 0)
+      {
+        cancel_deferred(get_sender_id(order.sender_id));
+      }
+      if (!compact)
+      {
+        append_expiry_actions(out.actions, order, until);
+      }
+    }
 
-      // undelegatebw action
-      action act1 = action(
-        permission_level{ order.creditor, N(creditorperm) },
-        N(eosio), N(undelegatebw),
-        std::make_tuple(order.creditor, order.beneficiary, order.net_staked, order.cpu_staked)
-      );
-      out.actions.emplace_back(act1);
-      //delete order entry
-      action act2 = action(
+    // compact mode, only order ids are kept in deferred transaction,
+    // `expire` rebuilds the actions from order entries when it runs
+    if (compact)
+    {
+      action act = action(
         permission_level{ CODE_ACCOUNT, N(bankperm) },
-        CODE_ACCOUNT, N(expireorder),
-        std::make_tuple(order_id)
+        CODE_ACCOUNT, N(expire),
+        std::make_tuple(order_ids, until)
       );
-      out.actions.emplace_back(act2);
+      out.actions.emplace_back(act);
+    }
 
-      //if order is_free is not free, transfer income to creditor
-      if (order.is_free == FALSE)
-      {
-        auto plan = p.get(order.plan_id);
+    if(out.actions.size() == 0)
+    {
+      return;
+    }
+    if(delay > 0) {
+      out.delay_sec = delay < MAX_EXPIRY_DELAY ? delay : MAX_EXPIRY_DELAY;
+    }
+    out.send(sender_id, CODE_ACCOUNT, true);
+  }
 
-        auto username = name{order.creditor};
-        std::string recipient_name = username.to_string();
-        std::string memo = recipient_name + " bankofstaked income";
+  //schedule deferred expiry of order at its earliest segment expiry, at most MAX_EXPIRY_DELAY ahead,
+  //same sender id replaces the pending one
+  void schedule_expiry(uint64_t order_id)
+  {
+    order_table o(CODE_ACCOUNT, get_order_scope(order_id));
+    auto order = o.get(order_id);
+    uint64_t delay = order.expire_at > now() ? order.expire_at - now() : 0;
 
-        // transfer income to creditor
-        asset income = get_income(order.creditor, order.price);
-        eosio_assert(income <= order.price, "income should not be greater than price");
-        action act3 = action(
-          permission_level{ CODE_ACCOUNT, N(bankperm) },
-          N(eosio.token), N(transfer),
-          std::make_tuple(CODE_ACCOUNT, MASK_TRANSFER, income, memo)
-        );
-        out.actions.emplace_back(act3);
+    std::vector<uint64_t> order_ids;
+    order_ids.emplace_back(order_id);
+    undelegate(order_ids, delay, order.expire_at);
+  }
 
-        // transfer reserved fund to STAKED_INCOME
-        asset reserved = order.price - income;
-        eosio_assert(reserved <= order.price, "reserved should not be greater than price");
-        username = name{STAKED_INCOME};
-        recipient_name = username.to_string();
-        memo = recipient_name + " bankofstaked reserved";
-        action act4 = action(
-          permission_level{ CODE_ACCOUNT, N(bankperm) },
-          N(eosio.token), N(transfer),
-          std::make_tuple(CODE_ACCOUNT, MASK_TRANSFER, reserved, memo)
-        );
-        out.actions.emplace_back(act4);
+  //INLINE ACTION to delegate CPU&NET from creditor to beneficiary,
+  //add cpu_staked&net_staked to creditor entry and reserve them from its available,
+  //a new delegation is counted against creditor's RAM, top-up of a live one reuses its delband row
+  void delegate(account_name creditor, account_name beneficiary, asset cpu, asset net, bool new_delegation=true)
+  {
+    if (is_safe_creditor(creditor)) {
+      INLINE_ACTION_SENDER(safedelegatebw, delegatebw)
+      (creditor, {{creditor, N(creditorperm)}}, {beneficiary, net, cpu});
+    } else {
+      INLINE_ACTION_SENDER(eosiosystem::system_contract, delegatebw)
+      (EOSIO, {{creditor, N(creditorperm)}}, {creditor, beneficiary, net, cpu, false});
+    }
+
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    auto creditor_itr = c.find(creditor);
+    eosio_assert(creditor_itr->available >= cpu + net, "creditor has no enough available balance");
+    eosio_assert(!new_delegation || has_ram_headroom(*creditor_itr), "creditor has no enough RAM");
+    c.modify(creditor_itr, RAM_PAYER, [&](auto &i) {
+      i.cpu_staked += cpu;
+      i.net_staked += net;
+      i.available -= cpu + net;
+      if(new_delegation) {
+        i.delegations += 1;
+      }
+      i.updated_at = now();
+    });
+  }
+
+  //merge paid purchase into live order buyer made for beneficiary, served by an active creditor, if any
+  //a live segment of the same plan is extended and existing delegation is kept,
+  //otherwise only the new plan is delegated and tracked as an extra segment
+  bool merge_order(account_name buyer, account_name beneficiary, const plan &plan)
+  {
+    orderidx_table x(CODE_ACCOUNT, SCOPE);
+    auto idx = x.get_index<N(beneficiary)>();
+    uint128_t key = get_account_key(beneficiary, FALSE);
+    auto itr = idx.lower_bound(key);
+    while(itr != idx.end() && itr->get_beneficiary_key() == key)
+    {
+      //segments carry no buyer, orders of other buyers are never merged into
+      if(itr->buyer != buyer)
+      {
+        itr++;
+        continue;
+      }
+      order_table o(CODE_ACCOUNT, get_order_scope(itr->order_id));
+      const auto &entry = o.get(itr->order_id);
+      if(entry.expire_at > now()
+          && is_active_creditor(entry.creditor)
+          && !is_split_order(entry))
+      {
+        return merge_into(entry, buyer, beneficiary, plan);
+      }
+      itr++;
+    }
+    return false;
+  }
 
+  //renew or top-up live paid order with plan
+  bool merge_into(const order &entry, account_name buyer, account_name beneficiary, const plan &plan)
+  {
+    //look for live segment of the same plan to renew
+    int renewed = -1;
+    for(int i=0; i<entry.segments.size(); i++)
+    {
+      if(entry.segments[i].plan_id == plan.id && entry.segments[i].expire_at > now())
+      {
+        renewed = i;
+        break;
       }
     }
 
-    if(duration > 0) {
-      out.delay_sec = duration * SECONDS_PER_MIN;
+    account_name creditor = entry.creditor;
+    //top-up, make sure creditor has enough balance to delegate the delta
+    if(renewed < 0
+        && (entry.segments.size() >= MAX_PAID_ORDERS || get_available(creditor) < plan.cpu + plan.net))
+    {
+      return false;
+    }
+
+    //no order is added, so only blacklist applies
+    validate_blacklist(buyer);
+    validate_blacklist(beneficiary);
+
+    if(renewed < 0)
+    {
+      delegate(creditor, beneficiary, plan.cpu, plan.net, false);
+    }
+
+    //INLINE ACTION to call check action of `bankofstaked`
+    INLINE_ACTION_SENDER(bankofstaked, check)
+    (CODE_ACCOUNT, {{CODE_ACCOUNT, N(bankperm)}}, {creditor});
+
+    uint64_t order_id = update_order(entry.id, [&](auto &i) {
+      if(renewed >= 0)
+      {
+        i.segments[renewed].price += plan.price;
+        i.segments[renewed].expire_at += plan.duration * SECONDS_PER_MIN;
+      }
+      else
+      {
+        segment s;
+        s.creditor = creditor;
+        s.plan_id = plan.id;
+        s.price = plan.price;
+        s.cpu = plan.cpu;
+        s.net = plan.net;
+        s.created_at = now();
+        s.expire_at = now() + plan.duration * SECONDS_PER_MIN;
+        i.segments.emplace_back(s);
+      }
+      sum_segments(i);
+    });
+
+    schedule_expiry(order_id);
+
+    metrics stats = get_metrics();
+    if(renewed >= 0) {
+      stats.renewals += 1;
+    } else {
+      stats.topups += 1;
+      stats.cpu_staked += plan.cpu;
+      stats.net_staked += plan.net;
     }
-    out.send((uint128_t(CODE_ACCOUNT) << 64) | current_time() | nonce, CODE_ACCOUNT, true);
+    save_metrics(stats);
+    return true;
   }
 
   //token received
@@ -529,30 +843,51 @@ private:
         return;
       }
       //validate plan, is_active should be TRUE
-      plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
-      auto idx = p.get_index<N(price)>();
-      auto plan = idx.find(t.quantity.amount);
+      auto plans = get_plans();
+      auto plan = find_plan(plans, t.quantity.amount);
+      eosio_assert(plan != plans.end(), "invalid price");
       eosio_assert(plan->is_active == TRUE, "plan is in-active");
-      eosio_assert(plan != idx.end(), "invalid price");
 
       account_name beneficiary = get_beneficiary(t.memo, buyer);
 
+      //renewal or top-up of a live paid order, only the delta gets delegated
+      if(plan->is_free == FALSE && merge_order(buyer, beneficiary, *plan))
+      {
+        return;
+      }
+
       // if plan is free, validate there is no Freelock for this beneficiary
       if(plan->is_free == TRUE)
       {
         validate_freelock(beneficiary);
       }
 
-      //get active creditor
-      account_name creditor = get_active_creditor(plan->is_free);
+      //get active creditor, active creditors are sharded by beneficiary
+      asset to_delegate = plan->cpu + plan->net;
+      account_name creditor = get_active_creditor(plan->is_free, beneficiary, to_delegate);
 
       //if plan is not free, make sure creditor has enough balance to delegate
-      if(plan->is_free == FALSE)
+      if(plan->is_free == FALSE && get_available(creditor) < to_delegate)
+      {
+          creditor = get_qualified_paid_creditor(to_delegate);
+      }
+
+      //no creditor is able to delegate the plan alone, split it across creditors
+      std::vector<segment> legs;
+      if(plan->is_free == FALSE && creditor == 0)
       {
-          asset to_delegate = plan->cpu + plan->net;
-          if(get_balance(creditor) < to_delegate) {
-            creditor = get_qualified_paid_creditor(to_delegate);
-          }
+          legs = split_plan(*plan, beneficiary);
+          creditor = legs[0].creditor;
+      }
+      else
+      {
+          segment s;
+          s.creditor = creditor;
+          s.plan_id = plan->id;
+          s.price = plan->price;
+          s.cpu = plan->cpu;
+          s.net = plan->net;
+          legs.emplace_back(s);
       }
 
       //make sure creditor is a valid account
@@ -570,47 +905,33 @@ private:
       //3. each beneficiary could only have 5 affective orders at most
       validate_beneficiary(beneficiary, creditor, plan->is_free);
 
-      //INLINE ACTION to delegate CPU&NET for beneficiary account
-      if (is_safe_creditor(creditor)) {
-        INLINE_ACTION_SENDER(safedelegatebw, delegatebw)
-        (creditor, {{creditor, N(creditorperm)}}, {beneficiary, plan->net, plan->cpu});
-      } else {
-        INLINE_ACTION_SENDER(eosiosystem::system_contract, delegatebw)
-        (EOSIO, {{creditor, N(creditorperm)}}, {creditor, beneficiary, plan->net, plan->cpu, false});
+      //INLINE ACTION to delegate CPU&NET for beneficiary account, from each creditor leg
+      for(int i=0; i<legs.size(); i++)
+      {
+        legs[i].created_at = now();
+        legs[i].expire_at = now() + plan->duration * SECONDS_PER_MIN;
+        delegate(legs[i].creditor, beneficiary, legs[i].cpu, legs[i].net);
       }
 
       //INLINE ACTION to call check action of `bankofstaked`
       INLINE_ACTION_SENDER(bankofstaked, check)
       (CODE_ACCOUNT, {{CODE_ACCOUNT, N(bankperm)}}, {creditor});
 
-      // add cpu_staked&net_staked to creditor entry
-      creditor_table c(CODE_ACCOUNT, SCOPE);
-      auto creditor_itr = c.find(creditor);
-      c.modify(creditor_itr, RAM_PAYER, [&](auto &i) {
-        i.cpu_staked += plan->cpu;
-        i.net_staked += plan->net;
-        i.balance = get_balance(creditor);
-        i.updated_at = now();
-      });
-
-      //create Order entry
-      uint64_t order_id;
-      order_table o(CODE_ACCOUNT, SCOPE);
-      o.emplace(RAM_PAYER, [&](auto &i) {
-        i.id = o.available_primary_key();
+      //create Order entry in partition of its expiry
+      uint64_t order_id = new_order_id(legs[0].expire_at);
+      order_table o(CODE_ACCOUNT, get_order_scope(order_id));
+      auto created = o.emplace(RAM_PAYER, [&](auto &i) {
+        i.id = order_id;
         i.buyer = buyer;
-        i.price = plan->price;
         i.creditor = creditor;
         i.beneficiary = beneficiary;
-        i.plan_id = plan->id;
-        i.cpu_staked = plan->cpu;
-        i.net_staked = plan->net;
         i.is_free = plan->is_free;
         i.created_at = now();
-        i.expire_at = now() + plan->duration * SECONDS_PER_MIN;
-
-        order_id = i.id;
+        i.sender_id = i.id;
+        i.segments = legs;
+        sum_segments(i);
       });
+      add_order_index(*created);
 
       if(plan->is_free == TRUE)
       {
@@ -628,18 +949,36 @@ private:
       }
 
       //deferred transaction to auto undelegate after expired
-      std::vector<uint64_t> order_ids;
-      order_ids.emplace_back(order_id);
-      undelegate(order_ids, plan->duration);
+      schedule_expiry(order_id);
+
+      metrics stats = get_metrics();
+      if(plan->is_free == TRUE) {
+        stats.free_orders += 1;
+      } else {
+        stats.paid_orders += 1;
+      }
+      stats.purchases += 1;
+      if(legs.size() > 1) {
+        stats.splits += 1;
+      }
+      stats.cpu_staked += plan->cpu;
+      stats.net_staked += plan->net;
+      save_metrics(stats);
     }
   }
 };
 
 extern "C"
 {
-  [[noreturn]] void apply(uint64_t receiver, uint64_t code, uint64_t action) {
+  [[noreturn]] void BANK_APPLY(uint64_t receiver, uint64_t code, uint64_t action) {
+#ifdef BANK_PROFILE
+    profile::receiver = receiver;
+#endif
     bankofstaked c(receiver);
     c.apply(code, action);
+#ifdef BANK_PROFILE
+    profile::print_ops(code, action);
+#endif
     eosio_exit(0);
   }
 }
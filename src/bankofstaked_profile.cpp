@@ -0,0 +1,3 @@
+// instrumentation build of bankofstaked, see include/bankofstaked/profile.hpp
+#define BANK_PROFILE
+#include <bankofstaked.cpp>
@@ -1,13 +1,24 @@
+#pragma once
+
 using namespace eosio;
 using namespace eosiosystem;
 using namespace bank;
 
 namespace lock
 {
-  //add freelock entry
+  //add freelock entry, an expired entry of beneficiary is reused in place
   void add_freelock(account_name beneficiary)
   {
     freelock_table f(CODE_ACCOUNT, SCOPE);
+    auto itr = f.find(beneficiary);
+    if(itr != f.end())
+    {
+      f.modify(itr, RAM_PAYER, [&](auto &i) {
+        i.created_at = now();
+        i.expire_at = i.created_at + SECONDS_PER_DAY;
+      });
+      return;
+    }
     f.emplace(RAM_PAYER, [&](auto &i) {
       i.beneficiary = beneficiary;
       i.created_at = now();
@@ -15,19 +26,18 @@ namespace lock
     });
   }
 
-  //delete expired freelock entries
-  void expire_freelock()
+  //delete freelock entries of day buckets ended before today, at most max_depth of them
+  //entries expired today are left for add_freelock to reuse
+  void expire_freelock(uint64_t max_depth = CHECK_MAX_DEPTH)
   {
     uint64_t depth = 0;
-    uint64_t n = now();
+    uint64_t today = now() / SECONDS_PER_DAY * SECONDS_PER_DAY;
     freelock_table f(CODE_ACCOUNT, SCOPE);
     auto idx = f.get_index<N(expire_at)>();
-    auto last = idx.upper_bound(n);
-    auto itr = idx.lower_bound(0);
-    while(itr!=last && depth < CHECK_MAX_DEPTH)
+    auto itr = idx.begin();
+    while(itr != idx.end() && itr->expire_at < today && depth < max_depth)
     {
-      idx.erase(itr);
-      itr = idx.lower_bound(0);
+      itr = idx.erase(itr);
       depth += 1;
     }
   }
@@ -0,0 +1,103 @@
+#pragma once
+
+using namespace eosio;
+using namespace bank;
+
+//helpers of both contracts on the tables bankadmin owns, and checks of admin actions.
+//bankadmin includes only this, bankofstaked includes it ahead of utils.cpp
+namespace utils
+{
+  //get config, defaults are used until setconfig is called
+  config get_config()
+  {
+    config defaults;
+    defaults.free_shards = DEFAULT_FREE_SHARDS;
+    defaults.paid_shards = DEFAULT_PAID_SHARDS;
+    defaults.rotate_depth = DEFAULT_ROTATE_DEPTH;
+    defaults.high_watermark = DEFAULT_HIGH_WATERMARK;
+    defaults.lag_threshold = DEFAULT_LAG_THRESHOLD;
+    defaults.max_batch = DEFAULT_MAX_EXPIRY_BATCH;
+    config_table cfg(ADMIN_ACCOUNT, SCOPE);
+    return cfg.get_or_default(defaults);
+  }
+
+  //read plans of plan table ordered by price
+  std::vector<plan> load_plans()
+  {
+    std::vector<plan> plans;
+    plan_table p(ADMIN_ACCOUNT, ADMIN_ACCOUNT);
+    for(auto itr = p.begin(); itr != p.end(); itr++)
+    {
+      plans.emplace_back(*itr);
+    }
+    std::sort(plans.begin(), plans.end(), [](const plan &a, const plan &b) {
+      return a.price.amount < b.price.amount;
+    });
+    return plans;
+  }
+
+  //get plans ordered by price from plandir, plan table is read until setplan or activateplan saves plandir
+  std::vector<plan> get_plans()
+  {
+    plandir_table d(ADMIN_ACCOUNT, ADMIN_ACCOUNT);
+    if(d.exists())
+    {
+      return d.get().plans;
+    }
+    return load_plans();
+  }
+
+  //copy plan table into plandir, called after every write to plan table
+  void save_plans()
+  {
+    plandir_table d(ADMIN_ACCOUNT, ADMIN_ACCOUNT);
+    plandir dir;
+    dir.plans = load_plans();
+    d.set(dir, ADMIN_RAM_PAYER);
+  }
+
+  //binary search plan of price in plans ordered by price, plans.end() if there is none
+  std::vector<plan>::const_iterator find_plan(const std::vector<plan> &plans, int64_t price)
+  {
+    auto itr = std::lower_bound(plans.begin(), plans.end(), price, [](const plan &p, int64_t amount) {
+      return p.price.amount < amount;
+    });
+    if(itr != plans.end() && itr->price.amount != price)
+    {
+      return plans.end();
+    }
+    return itr;
+  }
+}
+
+namespace validation
+{
+  //validate Plan asset fields
+  void validate_asset(asset price,
+                      asset cpu,
+                      asset net)
+  {
+    eosio_assert(price.is_valid(), "invalid price");
+    eosio_assert(cpu.is_valid(), "invalid cpu");
+    eosio_assert(net.is_valid(), "invalid net");
+    eosio_assert(price.amount >= 100 && price.amount <= 10000000, "price should between 0.01 EOS and 1000 EOS");
+  }
+
+  //batch of admin action should be sorted by key, so duplicates are caught by comparing neighbours
+  template<typename T, typename Key>
+  void validate_sorted(const std::vector<T> &batch, Key key)
+  {
+    for(int i=1; i<batch.size(); i++)
+    {
+      eosio_assert(key(batch[i-1]) < key(batch[i]), "batch should be sorted in ascending order without duplicates");
+    }
+  }
+
+  //validate account exist in creditor table
+  void validate_creditor(account_name creditor)
+  {
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    auto itr = c.find(creditor);
+    eosio_assert(itr != c.end(), "account does not exist in creditor table");
+  }
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 using namespace eosio;
 using namespace eosiosystem;
 using namespace bank;
@@ -16,27 +18,158 @@ namespace utils
     return to;
   }
 
-  //get active creditor from creditor table
-  account_name get_active_creditor(uint64_t for_free)
+  //get expiry backlog stats, check expires CHECK_MAX_DEPTH orders until lag is seen
+  expirystat get_expirystat()
+  {
+    expirystat defaults;
+    defaults.backlog = 0;
+    defaults.lag = 0;
+    defaults.max_lag = 0;
+    defaults.batch = CHECK_MAX_DEPTH;
+    defaults.updated_at = 0;
+    expirystat_table e(CODE_ACCOUNT, SCOPE);
+    return e.get_or_default(defaults);
+  }
+
+  //save backlog seen by check, expiry batch is doubled while lag is above lag_threshold,
+  //and halved back once backlog fits in one batch
+  void update_expirystat(uint64_t backlog, uint64_t lag, const config &cfg)
+  {
+    expirystat stat = get_expirystat();
+    uint64_t batch = stat.batch;
+    if(lag > cfg.lag_threshold)
+    {
+      batch = batch * 2 < cfg.max_batch ? batch * 2 : cfg.max_batch;
+    }
+    else if(backlog <= batch)
+    {
+      batch = batch / 2 > CHECK_MAX_DEPTH ? batch / 2 : CHECK_MAX_DEPTH;
+    }
+    if(stat.backlog == backlog && stat.lag == lag && stat.batch == batch)
+    {
+      return;
+    }
+    stat.backlog = backlog;
+    stat.lag = lag;
+    stat.batch = batch;
+    stat.updated_at = now();
+    expirystat_table e(CODE_ACCOUNT, SCOPE);
+    e.set(stat, RAM_PAYER);
+  }
+
+  //keep max lag between expire_at and actual expiry
+  void record_expiry_lag(uint64_t expire_at)
+  {
+    if(now() <= expire_at)
+    {
+      return;
+    }
+    expirystat stat = get_expirystat();
+    if(now() - expire_at <= stat.max_lag)
+    {
+      return;
+    }
+    stat.max_lag = now() - expire_at;
+    stat.updated_at = now();
+    expirystat_table e(CODE_ACCOUNT, SCOPE);
+    e.set(stat, RAM_PAYER);
+  }
+
+  //get counters of metrics table
+  metrics get_metrics()
+  {
+    metrics defaults;
+    defaults.free_orders = 0;
+    defaults.paid_orders = 0;
+    defaults.cpu_staked = asset(0, EOS_SYMBOL);
+    defaults.net_staked = asset(0, EOS_SYMBOL);
+    defaults.purchases = 0;
+    defaults.renewals = 0;
+    defaults.topups = 0;
+    defaults.splits = 0;
+    defaults.free_expired = 0;
+    defaults.paid_expired = 0;
+    defaults.rotations = 0;
+    defaults.checked_at = 0;
+    metrics_table m(CODE_ACCOUNT, SCOPE);
+    return m.get_or_default(defaults);
+  }
+
+  void save_metrics(const metrics &stats)
+  {
+    metrics_table m(CODE_ACCOUNT, SCOPE);
+    m.set(stats, RAM_PAYER);
+  }
+
+  //get active creditors of given kind from creditor table
+  std::vector<account_name> get_active_creditors(uint64_t for_free)
   {
-    uint64_t active = TRUE;
     creditor_table c(CODE_ACCOUNT, SCOPE);
     auto idx = c.get_index<N(is_active)>();
-    auto itr = idx.begin();
-    account_name creditor;
+    // only active entries, inactive ones are sorted before them
+    auto itr = idx.lower_bound(TRUE);
+    std::vector<account_name> creditors;
     while (itr != idx.end())
     {
-      if(itr->is_active != TRUE)
-      {
-         itr++;
-         continue;
+      if(itr->for_free == for_free) {
+        creditors.emplace_back(itr->account);
       }
+      itr++;
+    }
+    return creditors;
+  }
 
-      if(itr->for_free == for_free) {
+  //get shard of key among size active creditors
+  uint64_t get_shard(uint64_t key, uint64_t size)
+  {
+    // lower bits of account names are mostly 0, mix them before modulo
+    return ((key * 11400714819323198485ull) >> 32) % size;
+  }
+
+  //get RAM quota of account from eosio userres table, 0 if it has none
+  int64_t get_ram_bytes(account_name owner)
+  {
+    userres_table u(EOSIO, owner);
+    auto itr = u.find(owner);
+    if(itr == u.end()) {
+      return 0;
+    }
+    return itr->ram_bytes;
+  }
+
+  //estimate whether creditor has RAM for one more delband row, quota not read yet is not limited
+  bool has_ram_headroom(int64_t ram_bytes, uint64_t delegations)
+  {
+    return ram_bytes <= 0 || ram_bytes >= CREDITOR_RAM_RESERVED + int64_t(delegations + 1) * DELBAND_RAM_BYTES;
+  }
+
+  bool has_ram_headroom(const creditor &c)
+  {
+    return has_ram_headroom(c.ram_bytes, c.delegations);
+  }
+
+  //get active creditor from creditor table, active creditors are sharded by beneficiary,
+  //next active creditors are tried if the sharded one has less than to_delegate available or no RAM headroom
+  account_name get_active_creditor(uint64_t for_free, account_name beneficiary, asset to_delegate)
+  {
+    std::vector<account_name> creditors = get_active_creditors(for_free);
+    account_name creditor = 0;
+    if(creditors.size() == 0)
+    {
+      return creditor;
+    }
+    uint64_t shard = get_shard(beneficiary, creditors.size());
+    creditor = creditors[shard];
+
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    for(int i=0; i<creditors.size(); i++)
+    {
+      auto itr = c.find(creditors[(shard + i) % creditors.size()]);
+      if(itr->available >= to_delegate && has_ram_headroom(*itr))
+      {
         creditor = itr->account;
         break;
       }
-      itr++;
     }
     return creditor;
   }
@@ -50,36 +183,162 @@ namespace utils
     return balance;
   }
 
-  //get account EOS balance
+  //take refunding entry of creditor off once eosio has refunded it, its EOS is in the balance again.
+  //callers resetting available from balance drop it from unstaked cpu&net, so mature_refunds
+  //does not count it a second time. returns refunded cpu&net, zero while the refund is pending
+  refunding take_refunded(account_name creditor)
+  {
+    refunding refunded;
+    refunded.creditor = creditor;
+    refunded.cpu = asset(0, EOS_SYMBOL);
+    refunded.net = asset(0, EOS_SYMBOL);
+    refunded.matures_at = 0;
+    refunding_table r(CODE_ACCOUNT, SCOPE);
+    auto itr = r.find(creditor);
+    if(itr == r.end()) {
+      return refunded;
+    }
+    refundreq_table q(EOSIO, creditor);
+    if(q.find(creditor) != q.end()) {
+      return refunded;
+    }
+    refunded = *itr;
+    r.erase(itr);
+    return refunded;
+  }
+
+  //get account EOS balance, and reconcile available and RAM quota of creditor entry with it
   asset update_balance(account_name owner)
   {
     auto balance = get_balance(owner);
     // update creditor if update is true
     creditor_table c(CODE_ACCOUNT, SCOPE);
     auto creditor_itr = c.find(owner);
-    if(creditor_itr != c.end() && creditor_itr->balance != balance) {
+    if(creditor_itr == c.end()) {
+      return balance;
+    }
+    int64_t ram_bytes = get_ram_bytes(owner);
+    refunding refunded = take_refunded(owner);
+    if(creditor_itr->balance != balance || creditor_itr->available != balance || creditor_itr->ram_bytes != ram_bytes
+        || refunded.cpu.amount + refunded.net.amount > 0) {
       c.modify(creditor_itr, RAM_PAYER, [&](auto &i) {
+        i.cpu_unstaked -= refunded.cpu;
+        i.net_unstaked -= refunded.net;
         i.balance = balance;
+        i.available = balance;
+        i.ram_bytes = ram_bytes;
         i.updated_at = now();
       });
     }
     return balance;
   }
 
+  //queue unstaked cpu&net of creditor for eosio refund,
+  //every undelegatebw of creditor restarts the refund of all its unstaked EOS
+  void add_refunding(account_name creditor, asset cpu, asset net)
+  {
+    refunding_table r(CODE_ACCOUNT, SCOPE);
+    auto itr = r.find(creditor);
+    if(itr == r.end()) {
+      r.emplace(RAM_PAYER, [&](auto &i) {
+        i.creditor = creditor;
+        i.cpu = cpu;
+        i.net = net;
+        i.matures_at = now() + REFUND_DELAY;
+      });
+      return;
+    }
+    r.modify(itr, RAM_PAYER, [&](auto &i) {
+      i.cpu += cpu;
+      i.net += net;
+      i.matures_at = now() + REFUND_DELAY;
+    });
+  }
+
+  //deferred eosio refund of creditor, a failed refund does not abort the sender
+  void send_refund(account_name creditor)
+  {
+    eosio::transaction out;
+    action act = action(
+      permission_level{ creditor, N(creditorperm) },
+      EOSIO,
+      N(refund),
+      std::make_tuple(creditor)
+    );
+    out.actions.emplace_back(act);
+    out.send((uint128_t(creditor) << 64) | N(refund), CODE_ACCOUNT, true);
+  }
+
+  //settle at most max_depth refunding entries due by now.
+  //refunded ones are taken off unstaked cpu&net of creditor and its available is reconciled,
+  //mature ones eosio has not refunded yet get a refund sent, the others wait for their request_time.
+  //returns number of entries looked at
+  uint64_t mature_refunds(uint64_t max_depth)
+  {
+    refunding_table r(CODE_ACCOUNT, SCOPE);
+    auto idx = r.get_index<N(matures_at)>();
+    std::vector<account_name> due;
+    for(auto itr = idx.begin(); itr != idx.end() && itr->matures_at <= now() && due.size() < max_depth; itr++)
+    {
+      due.emplace_back(itr->creditor);
+    }
+
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    for(int i=0; i<due.size(); i++)
+    {
+      auto itr = r.find(due[i]);
+      refundreq_table q(EOSIO, due[i]);
+      auto request = q.find(due[i]);
+      if(request != q.end()) {
+        uint64_t matures_at = request->request_time + REFUND_DELAY;
+        if(matures_at <= now()) {
+          send_refund(due[i]);
+          matures_at = now() + REFUND_RETRY;
+        }
+        r.modify(itr, RAM_PAYER, [&](auto &j) {
+          j.matures_at = matures_at;
+        });
+        continue;
+      }
+
+      //refunded amounts are liquid again, available to delegate
+      auto creditor_itr = c.find(due[i]);
+      if(creditor_itr != c.end()) {
+        c.modify(creditor_itr, RAM_PAYER, [&](auto &j) {
+          j.cpu_unstaked -= itr->cpu;
+          j.net_unstaked -= itr->net;
+          j.available += itr->cpu + itr->net;
+          j.updated_at = now();
+        });
+      }
+      r.erase(itr);
+    }
+    return due.size();
+  }
+
+  //get amount of EOS creditor has left to delegate, without reading token contract
+  asset get_available(account_name creditor)
+  {
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    auto itr = c.find(creditor);
+    if(itr == c.end()) {
+      return asset(0, EOS_SYMBOL);
+    }
+    return itr->available;
+  }
+
 
 
-  //get creditor with balance >= to_delegate
+  //get creditor with balance >= to_delegate and RAM headroom
   account_name get_qualified_paid_creditor(asset to_delegate)
   {
-    uint64_t active = TRUE;
     creditor_table c(CODE_ACCOUNT, SCOPE);
     auto idx = c.get_index<N(is_active)>();
     auto itr = idx.begin();
-    account_name creditor;
+    account_name creditor = 0;
     while (itr != idx.end())
     {
-      asset balance = get_balance(itr->account);
-      if(itr->for_free == FALSE && balance >= to_delegate) {
+      if(itr->for_free == FALSE && itr->available >= to_delegate && has_ram_headroom(*itr)) {
         creditor = itr->account;
         break;
       }
@@ -102,6 +361,238 @@ namespace utils
     return price;
   }
 
+  //split plan into legs of active paid creditors when no single creditor is able to delegate it,
+  //each leg stakes cpu and net in plan proportion, at least MIN_LEG_STAKE,
+  //its share of price and creditor income out of it are at least 1 unit, so expiry never transfers 0
+  std::vector<segment> split_plan(const plan &plan, account_name beneficiary)
+  {
+    int64_t total = (plan.cpu + plan.net).amount;
+    int64_t remaining = total;
+    std::vector<segment> legs;
+
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    auto idx = c.get_index<N(is_active)>();
+    // active entries are sorted after inactive ones
+    auto itr = idx.end();
+    while (itr != idx.begin() && remaining > 0 && legs.size() < MAX_ORDER_LEGS)
+    {
+      itr--;
+      if(itr->is_active == FALSE)
+      {
+        break;
+      }
+      if(itr->for_free == TRUE || itr->account == beneficiary || !has_ram_headroom(*itr))
+      {
+        continue;
+      }
+      int64_t amount = itr->available.amount < remaining ? itr->available.amount : remaining;
+      // leave MIN_LEG_STAKE at least to the next leg
+      if(amount < remaining && remaining - amount < MIN_LEG_STAKE)
+      {
+        amount = remaining - MIN_LEG_STAKE;
+      }
+      asset price = asset(plan.price.amount * amount / total, EOS_SYMBOL);
+      if(amount < MIN_LEG_STAKE || price.amount < 1 || get_income(itr->account, price).amount < 1)
+      {
+        continue;
+      }
+      segment s;
+      s.creditor = itr->account;
+      s.plan_id = plan.id;
+      s.cpu = asset(plan.cpu.amount * amount / total, EOS_SYMBOL);
+      s.net = asset(amount, EOS_SYMBOL) - s.cpu;
+      s.price = price;
+      legs.emplace_back(s);
+      remaining -= amount;
+    }
+    eosio_assert(remaining == 0, "creditors have no enough balance to delegate");
+
+    // rounding leftover of price goes to the last leg
+    asset price = asset(0, EOS_SYMBOL);
+    for(int i=0; i<legs.size(); i++)
+    {
+      price += legs[i].price;
+    }
+    legs.back().price += plan.price - price;
+    return legs;
+  }
+
+  //check order has legs of more than one creditor or not
+  bool is_split_order(const order &entry)
+  {
+    for(int i=0; i<entry.segments.size(); i++)
+    {
+      if(entry.segments[i].creditor != entry.creditor)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //get sender id of deferred transaction which expires order
+  uint128_t get_sender_id(uint64_t order_sender_id)
+  {
+    return (uint128_t(CODE_ACCOUNT) << 64) | order_sender_id;
+  }
+
+  //sum up segments into price, cpu_staked and net_staked of order,
+  //expire_at of order is the earliest expiry of its segments
+  void sum_segments(order &entry)
+  {
+    eosio_assert(entry.segments.size() > 0, "order has no segment");
+    entry.plan_id = entry.segments[0].plan_id;
+    entry.price = entry.segments[0].price;
+    entry.cpu_staked = entry.segments[0].cpu;
+    entry.net_staked = entry.segments[0].net;
+    entry.expire_at = entry.segments[0].expire_at;
+    for(int i=1; i<entry.segments.size(); i++)
+    {
+      entry.price += entry.segments[i].price;
+      entry.cpu_staked += entry.segments[i].cpu;
+      entry.net_staked += entry.segments[i].net;
+      if(entry.segments[i].expire_at < entry.expire_at)
+      {
+        entry.expire_at = entry.segments[i].expire_at;
+      }
+    }
+  }
+
+  //key of buyer and beneficiary indices of orderidx table
+  uint128_t get_account_key(account_name account, uint64_t is_free)
+  {
+    return (uint128_t(account) << 64) | is_free;
+  }
+
+  //partition of orders expiring at expire_at
+  uint64_t get_partition(uint64_t expire_at)
+  {
+    return expire_at / ORDER_PARTITION_SECONDS;
+  }
+
+  //scope of order table partition
+  uint64_t get_partition_scope(uint64_t partition)
+  {
+    return SCOPE + partition;
+  }
+
+  //scope of order table partition holding order_id
+  uint64_t get_order_scope(uint64_t order_id)
+  {
+    return get_partition_scope(get_partition(order_id >> ORDER_SEQ_BITS));
+  }
+
+  //get partitions having live orders and seq of next order id
+  orderdir get_orderdir()
+  {
+    orderdir defaults;
+    defaults.next_seq = 0;
+    orderdir_table d(CODE_ACCOUNT, SCOPE);
+    return d.get_or_default(defaults);
+  }
+
+  void save_orderdir(const orderdir &dir)
+  {
+    orderdir_table d(CODE_ACCOUNT, SCOPE);
+    d.set(dir, RAM_PAYER);
+  }
+
+  //id of new order expiring at expire_at, its partition is listed in order directory.
+  //seq runs across all orders, so a new id never equals sender_id of a live order.
+  //directory is written on every new id, i.e. every purchase and every order move
+  uint64_t new_order_id(uint64_t expire_at)
+  {
+    orderdir dir = get_orderdir();
+    uint64_t partition = get_partition(expire_at);
+    auto itr = std::lower_bound(dir.partitions.begin(), dir.partitions.end(), partition);
+    if(itr == dir.partitions.end() || *itr != partition)
+    {
+      dir.partitions.insert(itr, partition);
+    }
+    uint64_t id = (expire_at << ORDER_SEQ_BITS) | dir.next_seq;
+    dir.next_seq = (dir.next_seq + 1) & ((1 << ORDER_SEQ_BITS) - 1);
+    save_orderdir(dir);
+    return id;
+  }
+
+  //list new order in orderidx
+  void add_order_index(const order &entry)
+  {
+    orderidx_table x(CODE_ACCOUNT, SCOPE);
+    x.emplace(RAM_PAYER, [&](auto &i) {
+      i.sender_id = entry.sender_id;
+      i.order_id = entry.id;
+      i.buyer = entry.buyer;
+      i.beneficiary = entry.beneficiary;
+      i.is_free = entry.is_free;
+    });
+  }
+
+  //drop expired order from orderidx
+  void remove_order_index(uint64_t sender_id)
+  {
+    orderidx_table x(CODE_ACCOUNT, SCOPE);
+    auto itr = x.find(sender_id);
+    if(itr != x.end())
+    {
+      x.erase(itr);
+    }
+  }
+
+  //apply updater to order, order is stored under a new id if its expire_at changed,
+  //sender_id is kept and orderidx follows the new id. returns order id after update
+  template<typename Lambda>
+  uint64_t update_order(uint64_t order_id, Lambda &&updater)
+  {
+    order_table o(CODE_ACCOUNT, get_order_scope(order_id));
+    auto itr = o.find(order_id);
+    eosio_assert(itr != o.end(), "order entry not found!!!");
+    order entry = *itr;
+    updater(entry);
+    if(entry.expire_at == itr->expire_at)
+    {
+      o.modify(itr, RAM_PAYER, [&](auto &i) {
+        i = entry;
+      });
+      return order_id;
+    }
+
+    o.erase(itr);
+    entry.id = new_order_id(entry.expire_at);
+    order_table moved(CODE_ACCOUNT, get_order_scope(entry.id));
+    moved.emplace(RAM_PAYER, [&](auto &i) {
+      i = entry;
+    });
+    orderidx_table x(CODE_ACCOUNT, SCOPE);
+    auto ref = x.find(entry.sender_id);
+    if(ref != x.end())
+    {
+      x.modify(ref, RAM_PAYER, [&](auto &i) {
+        i.order_id = entry.id;
+      });
+    }
+    return entry.id;
+  }
+
+  void deactivate_creditor(account_name account)
+  {
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    auto itr = c.find(account);
+    eosio_assert(itr != c.end(), "account not found in creditor table");
+    refunding refunded = take_refunded(account);
+    c.modify(itr, RAM_PAYER, [&](auto &i) {
+      i.is_active = FALSE;
+      i.cpu_unstaked -= refunded.cpu;
+      i.net_unstaked -= refunded.net;
+      i.balance = get_balance(i.account);
+      i.available = i.balance;
+      i.ram_bytes = get_ram_bytes(i.account);
+      i.updated_at = now();
+    });
+  }
+
+  //activate creditor, keep at most free_shards/paid_shards active creditors of its kind,
+  //active creditors with least available are deactivated first
   void activate_creditor(account_name account)
   {
     creditor_table c(CODE_ACCOUNT, SCOPE);
@@ -110,41 +601,46 @@ namespace utils
     //make sure specified creditor exists
     eosio_assert(creditor != c.end(), "account not found in creditor table");
 
+    uint64_t for_free = creditor->for_free;
+    refunding refunded = take_refunded(account);
+    c.modify(creditor, RAM_PAYER, [&](auto &i) {
+      i.is_active = TRUE;
+      i.cpu_unstaked -= refunded.cpu;
+      i.net_unstaked -= refunded.net;
+      i.balance = get_balance(i.account);
+      i.available = i.balance;
+      i.ram_bytes = get_ram_bytes(i.account);
+      i.updated_at = now();
+    });
+
     eosio::transaction out;
-    //activate creditor, deactivate others
-    auto itr = c.end();
-    while (itr != c.begin())
-    {
-      itr--;
-      if (itr->for_free != creditor->for_free) {
-        continue;
-      }
+    action act1 = action(
+      permission_level{ CODE_ACCOUNT, N(bankperm) },
+      CODE_ACCOUNT,
+      N(rotate),
+      std::make_tuple(account, for_free)
+    );
+    out.actions.emplace_back(act1);
+    out.send((uint128_t(CODE_ACCOUNT) << 64) | current_time(), CODE_ACCOUNT, true);
 
-      if(itr->account==creditor->account) {
-        c.modify(itr, RAM_PAYER, [&](auto &i) {
-          i.is_active = TRUE;
-          i.balance = get_balance(itr->account);
-          i.updated_at = now();
-        });
-        action act1 = action(
-          permission_level{ CODE_ACCOUNT, N(bankperm) },
-          CODE_ACCOUNT,
-          N(rotate),
-          std::make_tuple(itr->account, itr->for_free)
-        );
-        out.actions.emplace_back(act1);
-      } else {
-        if(itr->is_active == FALSE) {
-           continue;
+    config cfg = get_config();
+    uint64_t shards = for_free == TRUE ? cfg.free_shards : cfg.paid_shards;
+    std::vector<account_name> creditors = get_active_creditors(for_free);
+    while (creditors.size() > shards)
+    {
+      int exhausted = -1;
+      for(int i=0; i<creditors.size(); i++)
+      {
+        if(creditors[i] == account) {
+          continue;
+        }
+        if(exhausted < 0 || c.get(creditors[i]).available < c.get(creditors[exhausted]).available) {
+          exhausted = i;
         }
-        c.modify(itr, RAM_PAYER, [&](auto &i) {
-          i.is_active = FALSE;
-          i.balance = get_balance(itr->account);
-          i.updated_at = now();
-        });
       }
+      deactivate_creditor(creditors[exhausted]);
+      creditors.erase(creditors.begin() + exhausted);
     }
-    out.send((uint128_t(CODE_ACCOUNT) << 64) | current_time(), CODE_ACCOUNT, true);
   }
 
   //get min paid creditor balance
@@ -152,16 +648,14 @@ namespace utils
   {
 
     uint64_t balance = 10000 * 10000; // 10000 EOS
-    plan_table p(CODE_ACCOUNT, CODE_ACCOUNT);
-    eosio_assert(p.begin() != p.end(), "plan table is empty!");
-    auto itr = p.begin();
-    while (itr != p.end())
+    std::vector<plan> plans = get_plans();
+    eosio_assert(plans.size() > 0, "plan table is empty!");
+    for(int i=0; i<plans.size(); i++)
     {
-      auto required = itr->cpu.amount + itr->net.amount;
-      if (itr->is_free == false && itr->is_active && required < balance) {
+      auto required = plans[i].cpu.amount + plans[i].net.amount;
+      if (plans[i].is_free == false && plans[i].is_active && required < balance) {
         balance = required;
       }
-      itr++;
     }
     return balance;
   }
@@ -169,7 +663,7 @@ namespace utils
   //check creditor enabled safedelegate or not
   bool is_safe_creditor(account_name creditor)
   {
-    safecreditor_table s(CODE_ACCOUNT, SCOPE);
+    safecreditor_table s(ADMIN_ACCOUNT, SCOPE);
     auto itr = s.find(creditor);
     if(itr == s.end()){
       return false;
@@ -178,44 +672,112 @@ namespace utils
     }
   }
 
-  //rotate active creditor
-  void rotate_creditor()
+  //check creditor is currently active or not
+  bool is_active_creditor(account_name creditor)
   {
     creditor_table c(CODE_ACCOUNT, SCOPE);
-    auto free_creditor = get_active_creditor(TRUE);
-    auto paid_creditor = get_active_creditor(FALSE);
-
-    asset free_balance = get_balance(free_creditor);
-    asset paid_balance = get_balance(paid_creditor);
-    uint64_t min_paid_creditor_balance = get_min_paid_creditor_balance();
-    auto free_rotated = free_balance.amount > MIN_FREE_CREDITOR_BALANCE ?TRUE:FALSE;
-    auto paid_rotated = paid_balance.amount > min_paid_creditor_balance ?TRUE:FALSE;
-    auto idx = c.get_index<N(updated_at)>();
-    auto itr = idx.begin();
-    while (itr != idx.end())
+    auto itr = c.find(creditor);
+    if(itr == c.end()){
+      return false;
+    } else {
+      return itr->is_active == TRUE;
+    }
+  }
+
+  //rotate exhausted creditors of given kind out of active creditors,
+  //active creditors having no more than low_watermark available or no RAM headroom are exhausted,
+  //replacements need more than high_watermark% of low_watermark available and RAM headroom,
+  //at most rotate_depth creditors are examined from where the last rotation stopped
+  uint64_t rotate_shards(uint64_t for_free, uint64_t low_watermark, const config &cfg)
+  {
+    uint64_t shards = for_free == TRUE ? cfg.free_shards : cfg.paid_shards;
+    creditor_table c(CODE_ACCOUNT, SCOPE);
+    std::vector<account_name> exhausted;
+    std::vector<account_name> creditors = get_active_creditors(for_free);
+    for(int i=0; i<creditors.size(); i++)
     {
-      if(itr->for_free == TRUE)
+      const auto &entry = c.get(creditors[i]);
+      if(entry.available.amount <= low_watermark || !has_ram_headroom(entry)) {
+        exhausted.emplace_back(creditors[i]);
+      }
+    }
+    uint64_t healthy = creditors.size() - exhausted.size();
+    if(healthy >= shards)
+    {
+      return 0;
+    }
+
+    rotation_table r(CODE_ACCOUNT, SCOPE);
+    rotation state = r.get_or_default(rotation{});
+    account_name cursor = for_free == TRUE ? state.free_cursor : state.paid_cursor;
+    uint64_t high_watermark = low_watermark * cfg.high_watermark / 100;
+
+    //pick replacements, continue from cursor and wrap around creditor table
+    std::vector<account_name> replacements;
+    auto itr = c.upper_bound(cursor);
+    account_name first = 0;
+    uint64_t depth = 0;
+    while (depth < cfg.rotate_depth && healthy + replacements.size() < shards)
+    {
+      if(itr == c.end())
       {
-        if(free_rotated == TRUE){itr++;continue;}
-        auto balance = get_balance(itr->account);
-        if (itr->account != free_creditor && balance.amount > MIN_FREE_CREDITOR_BALANCE)
-        {
-          activate_creditor(itr->account);
-          free_rotated = TRUE;
-        }
-        itr++;
+        itr = c.begin();
+      }
+      if(itr == c.end() || itr->account == first)
+      {
+        break;
       }
-      else
+      if(depth == 0)
       {
-        if(paid_rotated == TRUE){itr++;continue;}
-        auto balance = get_balance(itr->account);
-        if (itr->account != paid_creditor && balance.amount > min_paid_creditor_balance)
-        {
-          activate_creditor(itr->account);
-          paid_rotated = TRUE;
+        first = itr->account;
+      }
+      cursor = itr->account;
+      depth++;
+
+      if(itr->for_free == for_free && itr->is_active == FALSE)
+      {
+        if(itr->available.amount > high_watermark && has_ram_headroom(*itr)) {
+          replacements.emplace_back(itr->account);
         }
-        itr++;
       }
+      itr++;
+    }
+
+    //a scan which ends where the last one did leaves nothing to save
+    if(cursor != (for_free == TRUE ? state.free_cursor : state.paid_cursor))
+    {
+      if(for_free == TRUE) {
+        state.free_cursor = cursor;
+      } else {
+        state.paid_cursor = cursor;
+      }
+      r.set(state, RAM_PAYER);
+    }
+
+    // exhausted creditors stay active until there is a replacement
+    for(int i=0; i<replacements.size(); i++)
+    {
+      if(i < exhausted.size()) {
+        deactivate_creditor(exhausted[i]);
+      }
+      activate_creditor(replacements[i]);
+    }
+
+    if(replacements.size() > 0)
+    {
+      metrics stats = get_metrics();
+      stats.rotations += replacements.size();
+      save_metrics(stats);
     }
+    return replacements.size();
+  }
+
+  //rotate active creditors, returns number of creditors activated
+  uint64_t rotate_creditor()
+  {
+    config cfg = get_config();
+    uint64_t rotations = rotate_shards(TRUE, MIN_FREE_CREDITOR_BALANCE, cfg);
+    rotations += rotate_shards(FALSE, get_min_paid_creditor_balance(), cfg);
+    return rotations;
   }
 }
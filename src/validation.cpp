@@ -1,3 +1,5 @@
+#pragma once
+
 using namespace eosio;
 using namespace eosiosystem;
 using namespace bank;
@@ -5,18 +7,18 @@ using namespace utils;
 
 namespace validation
 {
-  // check freelock
+  // check freelock, entry expired but not swept yet counts as absent
   void validate_freelock(account_name beneficiary)
   {
     freelock_table f(CODE_ACCOUNT, SCOPE);
     auto itr = f.find(beneficiary);
-    eosio_assert(itr == f.end(), "free plan is avaliable every 24 hours for each beneficiary");
+    eosio_assert(itr == f.end() || itr->expire_at <= now(), "free plan is avaliable every 24 hours for each beneficiary");
   }
 
   // check blacklist
   void validate_blacklist(account_name account)
   {
-    blacklist_table b(CODE_ACCOUNT, SCOPE);
+    blacklist_table b(ADMIN_ACCOUNT, SCOPE);
     auto itr = b.find(account);
     eosio_assert(itr == b.end(), "something wrong with your account");
   }
@@ -25,7 +27,7 @@ namespace validation
   uint64_t get_free_order_cap(account_name buyer)
   {
     uint64_t max_orders = MAX_FREE_ORDERS;
-    whitelist_table w(CODE_ACCOUNT, SCOPE);
+    whitelist_table w(ADMIN_ACCOUNT, SCOPE);
     auto itr = w.find(buyer);
     if(itr != w.end())
     {
@@ -51,17 +53,15 @@ namespace validation
     std::string suffix = " affective orders at most for each buyer";
     std::string error_msg = std::to_string(max_orders) + suffix;
 
-    order_table o(CODE_ACCOUNT, SCOPE);
-    auto idx = o.get_index<N(buyer)>();
-    auto first = idx.lower_bound(buyer);
-    auto last = idx.upper_bound(buyer);
+    //index range only holds orders of the same kind, of every partition
+    orderidx_table x(CODE_ACCOUNT, SCOPE);
+    auto idx = x.get_index<N(buyer)>();
+    uint128_t key = get_account_key(buyer, is_free);
+    auto first = idx.lower_bound(key);
     uint64_t count = 0;
-    while(first != last && first != idx.end())
+    while(first != idx.end() && first->get_buyer_key() == key && count < max_orders)
     {
-      if(first->is_free == is_free)
-      {
-        count += 1;
-      }
+      count += 1;
       first++;
     }
     eosio_assert(count < max_orders, error_msg.c_str());
@@ -91,41 +91,19 @@ namespace validation
     eosio_assert(balance.amount<MAX_EOS_BALANCE, "beneficiary should have no more than 500 EOS");
     */
 
-    order_table o(CODE_ACCOUNT, SCOPE);
-    auto idx = o.get_index<N(beneficiary)>();
-    auto first = idx.lower_bound(beneficiary);
-    auto last = idx.upper_bound(beneficiary);
+    //index range only holds orders of the same kind, of every partition
+    orderidx_table x(CODE_ACCOUNT, SCOPE);
+    auto idx = x.get_index<N(beneficiary)>();
+    uint128_t key = get_account_key(beneficiary, is_free);
+    auto first = idx.lower_bound(key);
     uint64_t count = 0;
-    while(first != last && first != idx.end())
+    while(first != idx.end() && first->get_beneficiary_key() == key && count < max_orders)
     {
-      if(first->is_free == is_free)
-      {
-        count += 1;
-      }
+      count += 1;
       first++;
     }
     std::string suffix = " affective orders at most for each beneficiary";
     std::string error_msg = std::to_string(max_orders) + suffix;
     eosio_assert(count < max_orders, error_msg.c_str());
   }
-
-
-  //validate Plan asset fields
-  void validate_asset(asset price,
-                      asset cpu,
-                      asset net)
-  {
-    eosio_assert(price.is_valid(), "invalid price");
-    eosio_assert(cpu.is_valid(), "invalid cpu");
-    eosio_assert(net.is_valid(), "invalid net");
-    eosio_assert(price.amount >= 100 && price.amount <= 10000000, "price should between 0.01 EOS and 1000 EOS");
-  }
-
-  //validate account exist in creditor table
-  void validate_creditor(account_name creditor)
-  {
-    creditor_table c(CODE_ACCOUNT, SCOPE);
-    auto itr = c.find(creditor);
-    eosio_assert(itr != c.end(), "account does not exist in creditor table");
-  }
 }
@@ -4,11 +4,19 @@ from eosapi import Client
 
 c = Client(nodes=['https://geo.eosasia.one'])
 
-def check_order(lower_bound=1):
+# orders are partitioned into scopes by expiry day, scope is 921459758687 + partition
+def fetch_partitions():
+    r = c.get_table_rows(**{"code": "bankofstaked", "scope": "921459758687", "table": "orderdir", "json": True, "limit": 1})
+    if not r["rows"]:
+        return [0]
+    return r["rows"][0]["partitions"]
+
+
+def check_order(scope, lower_bound=0):
     expired_orders = []
     now = time.time()
     new_lower_bound = lower_bound
-    r = c.get_table_rows(**{"code": "bankofstaked", "scope": "921459758687", "table": "order", "json": True, "limit": 100, "upper_bound": None, "lower_bound": lower_bound, "table_key": "id"})
+    r = c.get_table_rows(**{"code": "bankofstaked", "scope": str(921459758687 + scope), "table": "order", "json": True, "limit": 100, "upper_bound": None, "lower_bound": lower_bound, "table_key": "id"})
     more = r["more"]
     total_count = 0
     count = 0
@@ -34,6 +42,15 @@ def check_order(lower_bound=1):
 
 
 
+def fetch_metrics():
+    r = c.get_table_rows(**{"code": "bankofstaked", "scope": "921459758687", "table": "metrics", "json": True, "limit": 1})
+    if not r["rows"]:
+        return
+    print("=================METRICS==================")
+    pprint.pprint(r["rows"][0])
+    print("==========================================\n\n")
+
+
 def fetch_creditors():
     paid_accounts = []
     free_accounts = []
@@ -65,10 +82,8 @@ def get_account(a, free=True):
         refundings.append(r["refund_request"])
         balance += get_amount(r["refund_request"]["cpu_amount"]);
         balance += get_amount(r["refund_request"]["net_amount"]);
-    if free:
-        ram_required = balance * 0.16
-    else:
-        ram_required = balance * 0.12 / 30.
+    # same estimate as contract: reserved RAM plus one delband row per live delegation
+    ram_required = (4096 + a["delegations"] * 160) / 1024.
     #print(r["account_name"], liquid_balance)
     row = " | ".join([r["account_name"], str("%.4f EOS" % liquid_balance), str("%.4f EOS" % balance), str("%.2f" % (ram_quota/1024.)), str("%.2f" % ram_required), "✅" if (ram_quota/1024. > ram_required) else "❌"])
     row = "| %s |" % row
@@ -77,17 +92,19 @@ def get_account(a, free=True):
 
 
 if __name__ == "__main__":
+    fetch_metrics()
     bps = set()
     def get_name(d):
         """ Return the value of a key in a dictionary. """
         return d["expire_at"]
 
     expired = []
-    more, lower_bound, expired_orders = check_order()
-    expired.extend(expired_orders)
-    while more:
-        more, lower_bound, expired_orders = check_order(lower_bound=lower_bound)
+    for partition in fetch_partitions():
+        more, lower_bound, expired_orders = check_order(partition)
         expired.extend(expired_orders)
+        while more:
+            more, lower_bound, expired_orders = check_order(partition, lower_bound=lower_bound)
+            expired.extend(expired_orders)
 
     expired.sort(key=get_name)
     paid_ids = set()
@@ -0,0 +1,232 @@
+#pragma once
+#include <boost/test/unit_test.hpp>
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+#include "contracts.hpp"
+
+#include "Runtime/Runtime.h"
+
+#include <fc/variant_object.hpp>
+
+using namespace eosio::testing;
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using namespace fc;
+using namespace std;
+
+using mvo = fc::mutable_variant_object;
+
+class bankofstaked_tester : public tester
+{
+  public:
+    bankofstaked_tester(const vector<uint8_t> &bank_wasm = contracts::bank_wasm(),
+                        const vector<char> &bank_abi = contracts::bank_abi())
+    {
+       produce_blocks(2);
+
+        create_accounts({N(alice), N(bob), N(carol), N(eosio.token), N(bankofstaked), N(bankadmin)});
+        produce_blocks(2);
+
+        set_code(N(eosio.token), contracts::token_wasm());
+        set_abi(N(eosio.token), contracts::token_abi().data());
+
+        const auto &t = control->db().get<account_object, by_name>(N(eosio.token));
+        abi_def abi;
+        BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(t.abi, abi), true);
+        token_abi_ser.set_abi(abi, abi_serializer_max_time);
+
+        set_code(N(bankofstaked), bank_wasm);
+        set_abi(N(bankofstaked), bank_abi.data());
+        set_code(N(bankadmin), contracts::admin_wasm());
+        set_abi(N(bankadmin), contracts::admin_abi().data());
+
+        auto token = create(N(alice), asset::from_string("10000000.0000 EOS"));
+        produce_blocks(1);
+        issue(N(alice), N(alice), asset::from_string("500.0000 EOS"), "hola");
+        issue(N(alice), N(bob), asset::from_string("5000.0000 EOS"), "hola");
+        issue(N(alice), N(carol), asset::from_string("50000.0000 EOS"), "hola");
+        produce_blocks(1);
+
+        const auto &accnt = control->db().get<account_object, by_name>(N(bankofstaked));
+
+        abi_def bank_abi;
+        BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, bank_abi), true);
+        abi_ser.set_abi(bank_abi, abi_serializer_max_time);
+
+        const auto &admin = control->db().get<account_object, by_name>(N(bankadmin));
+        abi_def admin_abi;
+        BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(admin.abi, admin_abi), true);
+        admin_abi_ser.set_abi(admin_abi, abi_serializer_max_time);
+    }
+
+    action_result create(account_name issuer,
+                         asset maximum_supply)
+    {
+
+        return push_token_action(N(eosio.token), N(create), mvo()("issuer", issuer)("maximum_supply", maximum_supply));
+    }
+
+    action_result issue(account_name issuer, account_name to, asset quantity, string memo)
+    {
+        return push_token_action(issuer, N(issue), mvo()("to", to)("quantity", quantity)("memo", memo));
+    }
+
+    transaction_trace_ptr push_action(const account_name &signer, const action_name &name, const variant_object &data, bool auth = true)
+    {
+        vector<account_name> accounts;
+        if (auth)
+            accounts.push_back(signer);
+        auto trace = base_tester::push_action(N(bankofstaked), name, accounts, data);
+        produce_block();
+        BOOST_REQUIRE_EQUAL(true, chain_has_transaction(trace->id));
+        return trace;
+    }
+
+    // plans, config, whitelist and blacklist are set through bankadmin
+    transaction_trace_ptr push_admin_action(const action_name &name, const variant_object &data)
+    {
+        auto trace = base_tester::push_action(N(bankadmin), name, vector<account_name>{N(bankadmin)}, data);
+        produce_block();
+        BOOST_REQUIRE_EQUAL(true, chain_has_transaction(trace->id));
+        return trace;
+    }
+
+    action_result push_token_action(const account_name &signer, const action_name &name, const variant_object &data)
+    {
+        string action_type_name = token_abi_ser.get_action_type(name);
+
+        action act;
+        act.account = N(eosio.token);
+        act.name = name;
+        act.data = token_abi_ser.variant_to_binary(action_type_name, data, abi_serializer_max_time);
+
+        return base_tester::push_action(std::move(act), uint64_t(signer));
+    }
+
+    action_result transfer(account_name from,
+                           account_name to,
+                           asset quantity,
+                           string memo)
+    {
+        return push_token_action(from, N(transfer), mvo()("from", from)("to", to)("quantity", quantity)("memo", memo));
+    }
+
+    // same as scripts/bank_perm.sh, bankperm satisfied by bankofstaked@eosio.code
+    void set_bank_permissions()
+    {
+        set_authority(N(bankofstaked), N(bankperm), code_authority(N(bankofstaked)), config::active_name);
+        link_authority(N(bankofstaked), N(eosio.token), N(bankperm), N(transfer));
+        link_authority(N(bankofstaked), config::system_account_name, N(bankperm), N(delegatebw));
+        link_authority(N(bankofstaked), config::system_account_name, N(bankperm), N(undelegatebw));
+        for (auto name : {N(expire), N(expireorder), N(check), N(rotate)})
+            link_authority(N(bankofstaked), N(bankofstaked), N(bankperm), name);
+    }
+
+    // same as scripts/creditor_perm.sh without safedelegatebw
+    void set_creditor_permissions(account_name creditor)
+    {
+        set_authority(creditor, N(creditorperm), code_authority(creditor), config::active_name);
+        link_authority(creditor, config::system_account_name, N(creditorperm), N(delegatebw));
+        link_authority(creditor, config::system_account_name, N(creditorperm), N(undelegatebw));
+        link_authority(creditor, config::system_account_name, N(creditorperm), N(refund));
+    }
+
+    authority code_authority(account_name account)
+    {
+        return authority(1, {key_weight{get_public_key(account, "active"), 1}},
+                         {permission_level_weight{{N(bankofstaked), config::eosio_code_name}, 1}});
+    }
+
+    fc::variant get_creditor(const account_name &act)
+    {
+        vector<char> data = get_row_by_account(N(bankofstaked), 921459758687, N(creditor), act);
+        return data.empty() ? EMPTY : abi_ser.binary_to_variant("creditor", data, abi_serializer_max_time);
+    }
+
+    fc::variant get_blacklist(const account_name &act)
+    {
+        vector<char> data = get_row_by_account(N(bankadmin), 921459758687, N(blacklist), act);
+        return data.empty() ? EMPTY : admin_abi_ser.binary_to_variant("blacklist", data, abi_serializer_max_time);
+    }
+
+    fc::variant get_whitelist(const account_name &act)
+    {
+        vector<char> data = get_row_by_account(N(bankadmin), 921459758687, N(whitelist), act);
+        return data.empty() ? EMPTY : admin_abi_ser.binary_to_variant("whitelist", data, abi_serializer_max_time);
+    }
+
+    fc::variant get_config()
+    {
+        vector<char> data = get_row_by_account(N(bankadmin), 921459758687, N(config), N(config));
+        return data.empty() ? EMPTY : admin_abi_ser.binary_to_variant("config", data, abi_serializer_max_time);
+    }
+
+    // plandir singleton of bankadmin, plans ordered by price
+    fc::variant get_plandir()
+    {
+        vector<char> data = get_row_by_account(N(bankadmin), N(bankadmin), N(plandir), N(plandir));
+        return data.empty() ? EMPTY : admin_abi_ser.binary_to_variant("plandir", data, abi_serializer_max_time);
+    }
+
+    fc::variant get_account(account_name acc, const string &symbolname)
+    {
+        auto symb = eosio::chain::symbol::from_string(symbolname);
+        auto symbol_code = symb.to_symbol_code().value;
+        vector<char> data = get_row_by_account(N(eosio.token), acc, N(accounts), symbol_code);
+        return data.empty() ? EMPTY : token_abi_ser.binary_to_variant("account", data, abi_serializer_max_time);
+    }
+
+
+    vector<char> get_row_by_account(uint64_t code, uint64_t scope, uint64_t table, const account_name &act) const
+    {
+        vector<char> data;
+        const auto &db = control->db();
+        const auto *t_id = db.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(code, scope, table));
+        if (!t_id)
+        {
+            return data;
+        }
+        //FC_ASSERT( t_id != 0, "object not found" );
+
+        const auto &idx = db.get_index<chain::key_value_index, chain::by_scope_primary>();
+
+        auto itr = idx.lower_bound(boost::make_tuple(t_id->id, act));
+        if (itr == idx.end() || itr->t_id != t_id->id || act.value != itr->primary_key)
+        {
+            return data;
+        }
+
+        data.resize(itr->value.size());
+        memcpy(data.data(), itr->value.data(), data.size());
+        return data;
+    }
+
+    vector<char> get_row_by_creditor(uint64_t code, uint64_t scope, uint64_t table) const
+    {
+        vector<char> data;
+        const auto &db = control->db();
+        const auto *t_id = db.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(code, scope, table));
+        if (!t_id)
+        {
+            return data;
+        }
+
+        const auto &idx = db.get_index<chain::key_value_index, chain::by_scope_primary>();
+
+        auto itr = idx.lower_bound(boost::make_tuple(t_id->id));
+        if (itr == idx.end() || itr->t_id != t_id->id)
+        {
+            return data;
+        }
+
+        data.resize(itr->value.size());
+        memcpy(data.data(), itr->value.data(), data.size());
+        return data;
+    }
+
+    abi_serializer token_abi_ser;
+    abi_serializer abi_ser;
+    abi_serializer admin_abi_ser;
+    fc::variant EMPTY = fc::variant(0).as_string().substr(0,8);
+};
@@ -0,0 +1,218 @@
+#include "trace_replay.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+struct load_options
+{
+    uint32_t buyers = 2000;
+    uint32_t blocks = 200;
+    uint32_t start = 10;         // purchases in first block
+    uint32_t step = 10;          // purchases added each block
+    uint32_t max = 2000;         // purchases in a block at most
+    uint32_t interval = 60;      // seconds between blocks
+    uint32_t paid_percent = 30;  // share of paid purchases
+    uint32_t free_minutes = 60;  // plan durations, short enough for expiry to run during load
+    uint32_t paid_minutes = 240;
+    uint32_t trx_ms = 30;        // transaction deadline, 0 for none
+};
+
+struct load_summary
+{
+    uint64_t orders = 0;
+    uint64_t rejected = 0;
+    uint64_t deadline = 0;
+    uint32_t deadline_block = 0;  // first block with a transaction over deadline, 0 if none
+    uint32_t deadline_offered = 0;
+};
+
+// purchases of many buyers pushed into each block, growing by step until max,
+// while time moves on by interval so expiry and deferred transactions run alongside
+class load_generator : public trace_replayer
+{
+  public:
+    explicit load_generator(const load_options &o) : opts(o)
+    {
+        add_account(N(freecreditor), asset::from_string("1000000.0000 EOS"), true);
+        add_account(N(paidcreditor), asset::from_string("1000000.0000 EOS"), true);
+        admin(N(setplan), mvo()("price", "0.1000 EOS")("cpu", "1.0000 EOS")("net", "0.1000 EOS")("duration", opts.free_minutes)("is_free", true));
+        admin(N(setplan), mvo()("price", "1.0000 EOS")("cpu", "10.0000 EOS")("net", "1.0000 EOS")("duration", opts.paid_minutes)("is_free", false));
+        admin(N(activateplan), mvo()("price", "0.1000 EOS")("is_active", true));
+        admin(N(activateplan), mvo()("price", "1.0000 EOS")("is_active", true));
+        bank(N(addcreditor), mvo()("account", "freecreditor")("for_free", 1)("free_memo", "free"));
+        bank(N(addcreditor), mvo()("account", "paidcreditor")("for_free", 0)("free_memo", ""));
+        bank(N(activate), mvo()("account", "freecreditor"));
+        bank(N(activate), mvo()("account", "paidcreditor"));
+        wait(0);
+
+        // tester bills a fixed cpu for account creation, keep it well under block cpu limit
+        const string letters = "abcdefghijklmnopqrstuvwxyz";
+        for (uint32_t i = 0; i < opts.buyers; i++)
+        {
+            account_name buyer(string("loadbuyer") + letters[i / 26 / 26 % 26] + letters[i / 26 % 26] + letters[i % 26]);
+            add_account(buyer, asset::from_string("100.0000 EOS"), false);
+            buyers.push_back(buyer);
+            if ((i + 1) % 25 == 0)
+                wait(0);
+        }
+        wait(0);
+
+        result = replay_result();
+        if (opts.trx_ms > 0)
+            max_trx_time = fc::milliseconds(opts.trx_ms);
+    }
+
+    load_summary run(std::ostream &out)
+    {
+        map<uint32_t, uint32_t> offered;
+        uint64_t next = 0;
+        for (uint32_t b = 0; b < opts.blocks; b++)
+        {
+            uint32_t n = std::min(opts.start + b * opts.step, opts.max);
+            offered[control->head_block_num() + 1] = n;
+            for (uint32_t i = 0; i < n; i++, next++)
+            {
+                account_name buyer = buyers[next % buyers.size()];
+                bool paid = next * 7919 % 100 < opts.paid_percent;
+                push_step(buyer, N(eosio.token), N(transfer),
+                          mvo()("from", buyer)("to", "bankofstaked")("quantity", paid ? "1.0000 EOS" : "0.1000 EOS")("memo", buyer.to_string()));
+            }
+            wait(opts.interval);
+        }
+        return report(offered, out);
+    }
+
+  private:
+    load_options opts;
+    vector<account_name> buyers;
+
+    void bank(action_name name, const variant_object &data)
+    {
+        push_step(N(bankofstaked), N(bankofstaked), name, data);
+    }
+
+    void admin(action_name name, const variant_object &data)
+    {
+        push_step(N(bankadmin), N(bankadmin), name, data);
+    }
+
+    load_summary report(const map<uint32_t, uint32_t> &offered, std::ostream &out)
+    {
+        struct block_stats
+        {
+            uint32_t orders = 0;
+            uint32_t rejected = 0;
+            uint32_t deadline = 0;
+            uint64_t cpu_us = 0;
+        };
+        map<uint32_t, block_stats> blocks;
+        map<string, uint32_t> rejections;
+        vector<uint32_t> cpu;
+        load_summary s;
+        for (const auto &t : result.pushed)
+        {
+            block_stats &b = blocks[t.block];
+            if (t.error.empty())
+            {
+                b.orders++;
+                b.cpu_us += t.cpu_us;
+                cpu.push_back(t.cpu_us);
+            }
+            else if (t.deadline)
+            {
+                b.deadline++;
+                if (s.deadline_block == 0)
+                    s.deadline_block = t.block;
+            }
+            else
+            {
+                b.rejected++;
+                rejections[t.error]++;
+            }
+        }
+
+        out << "# blocks" << std::endl << "block,offered,orders,rejected,deadline,cpu_us" << std::endl;
+        uint32_t max_orders = 0;
+        for (const auto &o : offered)
+        {
+            const block_stats &b = blocks[o.first];
+            out << o.first << "," << o.second << "," << b.orders << "," << b.rejected << "," << b.deadline << "," << b.cpu_us << std::endl;
+            s.orders += b.orders;
+            s.rejected += b.rejected;
+            s.deadline += b.deadline;
+            max_orders = std::max(max_orders, b.orders);
+        }
+        if (s.deadline_block > 0)
+            s.deadline_offered = offered.at(s.deadline_block);
+
+        std::sort(cpu.begin(), cpu.end());
+        auto percentile = [&](uint32_t p) { return cpu.empty() ? 0 : cpu[(cpu.size() - 1) * p / 100]; };
+        out << "# summary" << std::endl
+            << "blocks,orders,orders_per_block,max_orders_per_block,rejected,deadline,cpu_p50_us,cpu_p90_us,cpu_p99_us,cpu_max_us,deadline_block,deadline_offered" << std::endl
+            << offered.size() << "," << s.orders << "," << s.orders / std::max<size_t>(offered.size(), 1) << "," << max_orders << ","
+            << s.rejected << "," << s.deadline << ","
+            << percentile(50) << "," << percentile(90) << "," << percentile(99) << "," << percentile(100) << ","
+            << s.deadline_block << "," << s.deadline_offered << std::endl;
+
+        out << "# deferred" << std::endl << "action,count,failed,elapsed_us" << std::endl;
+        for (const auto &d : result.deferred)
+            out << d.first << "," << d.second.count << "," << d.second.failed << "," << d.second.elapsed_us << std::endl;
+
+        out << "# rejected" << std::endl << "message,count" << std::endl;
+        for (const auto &r : rejections)
+            out << "'" << r.first << "'," << r.second << std::endl;
+        return s;
+    }
+};
+
+static uint32_t load_option(const string &name, uint32_t fallback)
+{
+    return std::stoul(option(name, std::to_string(fallback)));
+}
+
+BOOST_AUTO_TEST_SUITE(load_tests)
+
+// a few small blocks go through without hitting any limit
+BOOST_AUTO_TEST_CASE(load_test)
+try
+{
+    load_options o;
+    o.buyers = 100;
+    o.blocks = 5;
+    o.start = 5;
+    o.step = 5;
+    o.trx_ms = 0;
+    load_generator g(o);
+    std::ostringstream report;
+    load_summary s = g.run(report);
+    BOOST_REQUIRE(s.orders > 0);
+    BOOST_REQUIRE_EQUAL(s.deadline, 0);
+}
+FC_LOG_AND_RETHROW()
+
+// ./build/tests/unit_test --run_test=load_tests/load -- --buyers=2000 --blocks=200 --start=10 --step=10 [--snapshot=load.snapshot]
+BOOST_AUTO_TEST_CASE(load, *boost::unit_test::disabled())
+try
+{
+    load_options o;
+    o.buyers = load_option("buyers", o.buyers);
+    o.blocks = load_option("blocks", o.blocks);
+    o.start = load_option("start", o.start);
+    o.step = load_option("step", o.step);
+    o.max = load_option("max", o.max);
+    o.interval = load_option("interval", o.interval);
+    o.paid_percent = load_option("paid-percent", o.paid_percent);
+    o.free_minutes = load_option("free-minutes", o.free_minutes);
+    o.paid_minutes = load_option("paid-minutes", o.paid_minutes);
+    o.trx_ms = load_option("trx-ms", o.trx_ms);
+
+    load_generator g(o);
+    load_summary s = g.run(std::cout);
+    if (s.deadline_block > 0)
+        std::cout << "deadline first hit at " << s.deadline_offered << " purchases per block" << std::endl;
+    if (!option("snapshot").empty())
+        g.write_snapshot(option("snapshot"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,70 @@
+#include "trace_replay.hpp"
+
+#include <fstream>
+#include <iostream>
+
+BOOST_AUTO_TEST_SUITE(replay_tests)
+
+// same build replayed twice ends in the same state with the same failures
+BOOST_AUTO_TEST_CASE(replay_test)
+try
+{
+    auto steps = record_purchases(60).steps;
+
+    trace_replayer base;
+    trace_replayer candidate;
+    replay_result b = base.replay(steps);
+    replay_result c = candidate.replay(steps);
+
+    std::ostringstream report;
+    BOOST_REQUIRE_EQUAL(diff_state(b, c, report), 0);
+    BOOST_REQUIRE_EQUAL(b.pushed.size(), c.pushed.size());
+    for (size_t i = 0; i < b.pushed.size(); i++)
+        BOOST_REQUIRE_EQUAL(b.pushed[i].error, c.pushed[i].error);
+    BOOST_REQUIRE(b.state.size() > 0);
+}
+FC_LOG_AND_RETHROW()
+
+// ./build/tests/unit_test --run_test=replay_tests/record -- --trace=trace.json [--buyers=676] [--per-block=20]
+BOOST_AUTO_TEST_CASE(record, *boost::unit_test::disabled())
+try
+{
+    string path = option("trace", "trace.json");
+    record_purchases(std::stoul(option("buyers", "676")), std::stoul(option("per-block", "20"))).save(path);
+    std::cout << "trace written to " << path << std::endl;
+}
+FC_LOG_AND_RETHROW()
+
+// ./build/tests/unit_test --run_test=replay_tests/compare -- --trace=trace.json
+//     --candidate-wasm=other/bankofstaked.wasm [--candidate-abi=other/bankofstaked.abi]
+//     [--base-wasm=...] [--base-abi=...] [--report=report.csv]
+// wasm and abi default to build/, report to stdout
+BOOST_AUTO_TEST_CASE(compare, *boost::unit_test::disabled())
+try
+{
+    auto steps = trace_recorder::load(option("trace", "trace.json"));
+    auto wasm = [](const string &path) { return path.empty() ? contracts::bank_wasm() : read_wasm(path.c_str()); };
+    auto abi = [](const string &path) { return path.empty() ? contracts::bank_abi() : read_abi(path.c_str()); };
+
+    replay_result b, c;
+    {
+        trace_replayer base(wasm(option("base-wasm")), abi(option("base-abi")));
+        b = base.replay(steps);
+    }
+    {
+        trace_replayer candidate(wasm(option("candidate-wasm")), abi(option("candidate-abi")));
+        c = candidate.replay(steps);
+    }
+
+    string path = option("report");
+    std::ofstream file;
+    if (!path.empty())
+        file.open(path);
+    std::ostream &out = path.empty() ? std::cout : file;
+    uint32_t diffs = diff_state(b, c, out);
+    diff_cpu(b, c, out);
+    std::cout << diffs << " rows differ" << std::endl;
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,389 @@
+#pragma once
+#include "bankofstaked_tester.hpp"
+
+#include <fc/io/json.hpp>
+
+#include <fstream>
+#include <limits>
+#include <ostream>
+
+// value of --name=value given to unit_test after `--`
+inline string option(const string &name, const string &fallback = "")
+{
+    const auto &suite = boost::unit_test::framework::master_test_suite();
+    string prefix = "--" + name + "=";
+    for (int i = 1; i < suite.argc; i++)
+    {
+        string arg = suite.argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+            return arg.substr(prefix.size());
+    }
+    return fallback;
+}
+
+// A trace is a json array of steps, replayed in order
+//   {"account": "testaccouaaa", "balance": "10.0000 EOS", "creditor": false}
+//   {"actor": "testaccouaaa", "code": "eosio.token", "action": "transfer", "data": {...}}
+//   {"wait": 60}
+// actions go into pending block one transaction each, `wait` produces the block
+// that many seconds after head block, deferred transactions due by then run in it.
+class trace_recorder
+{
+  public:
+    void account(account_name name, asset balance, bool creditor = false)
+    {
+        steps.push_back(mvo()("account", name)("balance", balance)("creditor", creditor));
+    }
+
+    void action(account_name actor, account_name code, action_name name, const variant_object &data)
+    {
+        steps.push_back(mvo()("actor", actor)("code", code)("action", name)("data", data));
+    }
+
+    // creditor management of bankofstaked
+    void bank(action_name name, const variant_object &data)
+    {
+        action(N(bankofstaked), N(bankofstaked), name, data);
+    }
+
+    // plans, config and lists of bankadmin
+    void admin(action_name name, const variant_object &data)
+    {
+        action(N(bankadmin), N(bankadmin), name, data);
+    }
+
+    void transfer(account_name from, asset quantity, const string &memo)
+    {
+        action(from, N(eosio.token), N(transfer), mvo()("from", from)("to", "bankofstaked")("quantity", quantity)("memo", memo));
+    }
+
+    void wait(uint32_t seconds)
+    {
+        steps.push_back(mvo()("wait", seconds));
+    }
+
+    void save(const string &path) const
+    {
+        fc::json::save_to_file(fc::variant(steps), path, true);
+    }
+
+    static fc::variants load(const string &path)
+    {
+        return fc::json::from_file(path).get_array();
+    }
+
+    fc::variants steps;
+};
+
+struct trx_cost
+{
+    string label;        // code::action
+    uint32_t block;      // block the transaction went into
+    uint32_t cpu_us;     // billed, measured since replay pushes with billed_cpu_time_us = 0
+    int64_t elapsed_us;
+    string error;        // empty if transaction succeeded
+    bool deadline;       // failed on transaction deadline, transaction or block cpu limit
+};
+
+struct cost_sum
+{
+    uint64_t count = 0;
+    uint64_t failed = 0;
+    uint64_t cpu_us = 0;
+    uint64_t elapsed_us = 0;
+};
+
+struct replay_result
+{
+    vector<trx_cost> pushed;         // one entry per action step, in trace order
+    map<string, cost_sum> deferred;  // deferred transactions by first action, tester bills them a fixed cpu so elapsed is what to compare
+    map<string, string> state;       // code/scope/table/primary_key -> row json, tables of bankofstaked, bankadmin and eosio.token
+};
+
+class trace_replayer : public bankofstaked_tester
+{
+  public:
+    trace_replayer(const vector<uint8_t> &bank_wasm = contracts::bank_wasm(),
+                   const vector<char> &bank_abi = contracts::bank_abi())
+        : bankofstaked_tester(bank_wasm, bank_abi)
+    {
+        set_bank_permissions();
+        produce_block();
+        control->applied_transaction.connect([this](const transaction_trace_ptr &t) { on_applied(t); });
+    }
+
+    replay_result replay(const fc::variants &steps)
+    {
+        result = replay_result();
+        for (const auto &step : steps)
+        {
+            const auto &s = step.get_object();
+            if (s.contains("wait"))
+                wait(s["wait"].as<uint32_t>());
+            else if (s.contains("account"))
+                add_account(s["account"].as<account_name>(), asset::from_string(s["balance"].as_string()), s["creditor"].as_bool());
+            else
+                push_step(s["actor"].as<account_name>(), s["code"].as<account_name>(), s["action"].as<action_name>(), s["data"].get_object());
+        }
+        wait(0);
+        result.state = dump_state();
+        return result;
+    }
+
+    // deadline of each pushed transaction, like max-transaction-time of a producer
+    fc::microseconds max_trx_time = fc::microseconds::maximum();
+
+    // contract tables of codes in portable snapshot layout (native/snapshot.hpp), for native/export.
+    // only contract_tables section is written, secondary indices are left empty
+    void write_snapshot(const string &path, const vector<account_name> &codes = {N(bankadmin), N(bankofstaked)}) const
+    {
+        std::ofstream out(path, std::ios::binary);
+        auto write = [&](const auto &v) {
+            auto bytes = fc::raw::pack(v);
+            out.write(bytes.data(), bytes.size());
+        };
+        write(uint32_t(0x30510550));
+        write(uint32_t(1));
+        auto section = out.tellp();
+        write(std::numeric_limits<uint64_t>::max());
+        write(std::numeric_limits<uint64_t>::max());
+        out.write("contract_tables", sizeof("contract_tables"));
+
+        uint64_t count = 0;
+        const auto &db = control->db();
+        const auto &tables = db.get_index<chain::table_id_multi_index, chain::by_code_scope_table>();
+        const auto &idx = db.get_index<chain::key_value_index, chain::by_scope_primary>();
+        for (account_name code : codes)
+        {
+            for (auto t = tables.lower_bound(boost::make_tuple(code, scope_name(), table_name())); t != tables.end() && t->code == code; ++t)
+            {
+                write(t->code);
+                write(t->scope);
+                write(t->table);
+                write(t->payer);
+                write(t->count);
+                auto first = idx.lower_bound(boost::make_tuple(t->id));
+                auto last = idx.lower_bound(boost::make_tuple(t->id + 1));
+                uint32_t rows = std::distance(first, last);
+                write(fc::unsigned_int(rows));
+                for (auto itr = first; itr != last; ++itr)
+                {
+                    write(itr->primary_key);
+                    write(itr->payer);
+                    write(fc::unsigned_int(itr->value.size()));
+                    out.write(itr->value.data(), itr->value.size());
+                }
+                for (int i = 0; i < 5; i++)
+                    write(fc::unsigned_int(0));
+                count += 7 + rows;
+            }
+        }
+
+        auto end = out.tellp();
+        out.seekp(section);
+        write(uint64_t(end - section) - sizeof(uint64_t));
+        write(count);
+        out.seekp(end);
+        write(std::numeric_limits<uint64_t>::max());
+    }
+
+  protected:
+    replay_result result;
+    bool producing = false;
+    uint32_t nonce = 0;
+
+    void wait(uint32_t seconds)
+    {
+        producing = true;
+        if (seconds == 0)
+            produce_block();
+        else
+            produce_block(fc::seconds(seconds));
+        producing = false;
+    }
+
+    void add_account(account_name name, asset balance, bool creditor)
+    {
+        create_account(name);
+        if (balance.get_amount() > 0)
+            issue(N(alice), name, balance, "");
+        if (creditor)
+            set_creditor_permissions(name);
+    }
+
+    void push_step(account_name actor, account_name code, action_name name, const variant_object &data)
+    {
+        trx_cost cost{code.to_string() + "::" + name.to_string(), control->head_block_num() + 1, 0, 0, "", false};
+        try
+        {
+            signed_transaction trx;
+            trx.actions.emplace_back(get_action(code, name, {permission_level{actor, config::active_name}}, data));
+            // identical actions in one block would share a transaction id, expiration tells them apart
+            set_transaction_headers(trx, DEFAULT_EXPIRATION_DELTA + (nonce++ % 3000));
+            trx.sign(get_private_key(actor, "active"), control->get_chain_id());
+            auto deadline = max_trx_time == fc::microseconds::maximum() ? fc::time_point::maximum() : fc::time_point::now() + max_trx_time;
+            auto trace = push_transaction(trx, deadline, 0);
+            cost.cpu_us = trace->receipt->cpu_usage_us;
+            cost.elapsed_us = trace->elapsed.count();
+        }
+        catch (const fc::exception &e)
+        {
+            cost.error = e.top_message();
+            cost.deadline = e.code() == deadline_exception::code_value ||
+                            e.code() == leeway_deadline_exception::code_value ||
+                            e.code() == tx_cpu_usage_exceeded::code_value ||
+                            e.code() == block_cpu_usage_exceeded::code_value;
+        }
+        result.pushed.push_back(cost);
+    }
+
+    void on_applied(const transaction_trace_ptr &t)
+    {
+        if (!producing || t->action_traces.empty())
+            return;
+        const auto &act = t->action_traces.front().act;
+        if (act.name == N(onblock))
+            return;
+        cost_sum &sum = result.deferred[act.account.to_string() + "::" + act.name.to_string()];
+        sum.count++;
+        if (t->except)
+            sum.failed++;
+        if (t->receipt)
+            sum.cpu_us += t->receipt->cpu_usage_us;
+        sum.elapsed_us += t->elapsed.count();
+    }
+
+    map<string, string> dump_state()
+    {
+        map<string, string> rows;
+        dump_tables(N(bankofstaked), abi_ser, rows);
+        dump_tables(N(bankadmin), admin_abi_ser, rows);
+        dump_tables(N(eosio.token), token_abi_ser, rows);
+        return rows;
+    }
+
+    void dump_tables(account_name code, const abi_serializer &abis, map<string, string> &rows) const
+    {
+        const auto &db = control->db();
+        const auto &tables = db.get_index<chain::table_id_multi_index, chain::by_code_scope_table>();
+        const auto &idx = db.get_index<chain::key_value_index, chain::by_scope_primary>();
+        for (auto t = tables.lower_bound(boost::make_tuple(code, scope_name(), table_name())); t != tables.end() && t->code == code; ++t)
+        {
+            string type = abis.get_table_type(t->table);
+            for (auto itr = idx.lower_bound(boost::make_tuple(t->id)); itr != idx.end() && itr->t_id == t->id; ++itr)
+            {
+                vector<char> data(itr->value.begin(), itr->value.end());
+                string key = code.to_string() + "/" + t->scope.to_string() + "/" + t->table.to_string() + "/" + std::to_string(itr->primary_key);
+                rows[key] = type.empty() ? fc::to_hex(data) : fc::json::to_string(abis.binary_to_variant(type, data, abi_serializer_max_time));
+            }
+        }
+    }
+};
+
+// one free plan purchase of each buyer, every 4th buyer also buys paid plan
+inline trace_recorder record_purchases(uint32_t buyers, uint32_t per_block = 20)
+{
+    trace_recorder r;
+    r.account(N(freecreditor), asset::from_string("100000.0000 EOS"), true);
+    r.account(N(paidcreditor), asset::from_string("100000.0000 EOS"), true);
+    r.admin(N(setplan), mvo()("price", "0.1000 EOS")("cpu", "1.0000 EOS")("net", "0.1000 EOS")("duration", 1)("is_free", true));
+    r.admin(N(setplan), mvo()("price", "1.0000 EOS")("cpu", "10.0000 EOS")("net", "1.0000 EOS")("duration", 1)("is_free", false));
+    r.admin(N(activateplan), mvo()("price", "0.1000 EOS")("is_active", true));
+    r.admin(N(activateplan), mvo()("price", "1.0000 EOS")("is_active", true));
+    r.bank(N(addcreditor), mvo()("account", "freecreditor")("for_free", 1)("free_memo", "free"));
+    r.bank(N(addcreditor), mvo()("account", "paidcreditor")("for_free", 0)("free_memo", ""));
+    r.bank(N(activate), mvo()("account", "freecreditor"));
+    r.bank(N(activate), mvo()("account", "paidcreditor"));
+    r.wait(0);
+
+    const string letters = "abcdefghijklmnopqrstuvwxyz";
+    for (uint32_t i = 0; i < buyers; i++)
+    {
+        account_name buyer(string("testacc") + letters[i / 26 / 26 % 26] + letters[i / 26 % 26] + letters[i % 26]);
+        r.account(buyer, asset::from_string("10.0000 EOS"));
+        r.transfer(buyer, asset::from_string("0.1000 EOS"), buyer.to_string());
+        if (i % 4 == 0)
+            r.transfer(buyer, asset::from_string("1.0000 EOS"), buyer.to_string());
+        if ((i + 1) % per_block == 0)
+            r.wait(0);
+    }
+    // plans last a minute, wait for undelegate and then refund
+    r.wait(70);
+    r.wait(70);
+    return r;
+}
+
+// row differences of candidate against base, returns number of differing rows
+inline uint32_t diff_state(const replay_result &base, const replay_result &candidate, std::ostream &out)
+{
+    uint32_t diffs = 0;
+    out << "# state" << std::endl << "row,base,candidate" << std::endl;
+    auto b = base.state.begin();
+    auto c = candidate.state.begin();
+    while (b != base.state.end() || c != candidate.state.end())
+    {
+        if (c == candidate.state.end() || (b != base.state.end() && b->first < c->first))
+        {
+            out << b->first << ",'" << b->second << "'," << std::endl;
+            diffs++;
+            ++b;
+        }
+        else if (b == base.state.end() || c->first < b->first)
+        {
+            out << c->first << ",,'" << c->second << "'" << std::endl;
+            diffs++;
+            ++c;
+        }
+        else
+        {
+            if (b->second != c->second)
+            {
+                out << b->first << ",'" << b->second << "','" << c->second << "'" << std::endl;
+                diffs++;
+            }
+            ++b;
+            ++c;
+        }
+    }
+    return diffs;
+}
+
+// per transaction and per action billed cpu of both builds
+inline void diff_cpu(const replay_result &base, const replay_result &candidate, std::ostream &out)
+{
+    map<string, std::pair<cost_sum, cost_sum>> totals;
+    out << "# transactions" << std::endl << "step,action,base_us,candidate_us,base_error,candidate_error" << std::endl;
+    for (size_t i = 0; i < std::max(base.pushed.size(), candidate.pushed.size()); i++)
+    {
+        trx_cost b = i < base.pushed.size() ? base.pushed[i] : trx_cost();
+        trx_cost c = i < candidate.pushed.size() ? candidate.pushed[i] : trx_cost();
+        out << i << "," << b.label << "," << b.cpu_us << "," << c.cpu_us << ",'" << b.error << "','" << c.error << "'" << std::endl;
+
+        auto &t = totals[b.label];
+        t.first.count++;
+        t.first.failed += b.error.empty() ? 0 : 1;
+        t.first.cpu_us += b.cpu_us;
+        t.first.elapsed_us += b.elapsed_us;
+        t.second.count++;
+        t.second.failed += c.error.empty() ? 0 : 1;
+        t.second.cpu_us += c.cpu_us;
+        t.second.elapsed_us += c.elapsed_us;
+    }
+
+    out << "# actions" << std::endl << "action,deferred,base_count,base_failed,base_cpu_us,base_elapsed_us,candidate_count,candidate_failed,candidate_cpu_us,candidate_elapsed_us" << std::endl;
+    auto row = [&](const string &label, bool deferred, const cost_sum &b, const cost_sum &c) {
+        out << label << "," << deferred << ","
+            << b.count << "," << b.failed << "," << b.cpu_us << "," << b.elapsed_us << ","
+            << c.count << "," << c.failed << "," << c.cpu_us << "," << c.elapsed_us << std::endl;
+    };
+    for (const auto &t : totals)
+        row(t.first, false, t.second.first, t.second.second);
+
+    map<string, std::pair<cost_sum, cost_sum>> deferred;
+    for (const auto &d : base.deferred)
+        deferred[d.first].first = d.second;
+    for (const auto &d : candidate.deferred)
+        deferred[d.first].second = d.second;
+    for (const auto &d : deferred)
+        row(d.first, true, d.second.first, d.second.second);
+}